@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <algorithm>
+#include "json.hpp"
+
+using namespace std;
+using namespace JSON;
+
+// times parse, write, compact and lookup on inputs of size n and 8n along several axes;
+// linear work grows about eight fold and a quadratic path sixty four fold, so a row
+// fails when it grows past thirty two. Timing is kept out of json_test, run it
+// with make bench && ./bench
+
+static const int runs = 5;
+static const double max_growth = 32;
+
+// median of runs in seconds of processor time, the time other processes hold the
+// processor is not counted
+template <typename Run>
+static double median_time(Run run) {
+    vector<double> spent;
+    for (int i = 0; i < runs; i++) {
+        clock_t start = clock();
+        run();
+        spent.push_back(static_cast<double>(clock() - start) / CLOCKS_PER_SEC);
+    }
+    sort(spent.begin(), spent.end());
+    return spent[runs / 2];
+}
+
+// every node once, members through a lookup of their own name
+static size_t visit_nodes(const Value& root) {
+    size_t count = 1;
+    if (root.isArray()) {
+        for (auto& e : root)
+            count += visit_nodes(e);
+    }
+    else if (root.isObject()) {
+        for (auto mt = root.begin(); mt != root.end(); ++mt)
+            count += visit_nodes(*root.find(mt.name()));
+    }
+    return count;
+}
+
+static bool expect_linear(const char* axis, string (*generate)(size_t), size_t n) {
+    double times[2][4];
+    for (int large = 0; large < 2; large++) {
+        string text = generate(large ? 8 * n : n);
+        Value value;
+        Reader reader;
+        if (reader.read(text, value) != PARSE_OK) {
+            printf("%s: the generated input does not parse\n", axis);
+            return false;
+        }
+        times[large][0] = median_time([&]() { reader.read(text, value); });
+        times[large][1] = median_time([&]() { FastWriter().write(value); });
+        // compact() rebuilds every payload, which a plain copy of the Value does not
+        times[large][2] = median_time([&]() { Value copy = value; copy.compact(); });
+        times[large][3] = median_time([&]() { visit_nodes(value); });
+    }
+    const char* names[] = { "parse", "write", "compact", "lookup" };
+    bool all_linear = true;
+    for (int i = 0; i < 4; i++) {
+        // a little slack for timer noise on runs of a few microseconds
+        bool linear = times[1][i] < times[0][i] * max_growth + 0.001;
+        all_linear = all_linear && linear;
+        printf("%-15s %-8s %10.6fs %10.6fs %6.1fx %s\n", axis, names[i], times[0][i], times[1][i],
+               times[0][i] > 0 ? times[1][i] / times[0][i] : 0.0, linear ? "" : "FAILED");
+    }
+    return all_linear;
+}
+
+static string generate_wide(size_t n) {
+    string text = "[";
+    for (size_t i = 0; i < n; i++)
+        text += i == 0 ? "{ \"id\" : 1, \"ok\" : true }" : ", { \"id\" : 1, \"ok\" : true }";
+    return text + "]";
+}
+
+static string generate_deep(size_t n) {
+    return string(n, '[') + string(n, ']');
+}
+
+static string generate_long_string(size_t n) {
+    return "\"" + string(n, 'a') + "\"";
+}
+
+static string generate_many_keys(size_t n) {
+    string text = "{";
+    for (size_t i = 0; i < n; i++)
+        text += (i == 0 ? "\"key" : ", \"key") + to_string(i) + "\" : null";
+    return text + "}";
+}
+
+static string generate_escapes(size_t n) {
+    string text = "\"";
+    for (size_t i = 0; i < n; i++)
+        text += "\\n\\\"\\u00e9\\ud834\\udd1e";
+    return text + "\"";
+}
+
+int main() {
+    printf("%-15s %-8s %11s %11s %7s\n", "axis", "phase", "n", "8n", "growth");
+    bool linear = true;
+    linear = expect_linear("width", generate_wide, 20000) && linear;
+    linear = expect_linear("depth", generate_deep, 1250) && linear;
+    linear = expect_linear("string length", generate_long_string, 1000000) && linear;
+    linear = expect_linear("key count", generate_many_keys, 20000) && linear;
+    linear = expect_linear("escape density", generate_escapes, 40000) && linear;
+    return linear ? 0 : 1;
+}
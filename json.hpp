@@ -11,6 +11,41 @@
 #include <cstdlib>
 #include <cmath>
 #include <cassert>
+#include <cerrno>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+#include <unordered_set>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+// file descriptors and mmap (StreamWriter on an fd, OffsetIndex) need POSIX
+#if defined(__unix__) || defined(__APPLE__)
+#define JSON_HAS_POSIX 1
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if __cplusplus >= 201703L
+#include <optional>
+#include <string_view>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef JSON_USE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace JSON {
     // error number
@@ -28,7 +63,26 @@ namespace JSON {
         PARSE_MISS_COMMA_OR_SQUARE_BRAKET,
         PARSE_MISS_KEY,
         PARSE_MISS_COLON,
-        PARSE_MISS_COMMA_OR_CURLY_BRACKET
+        PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+        PARSE_TYPE_MISMATCH,
+        PARSE_INVALID_UTF8,
+        PARSE_INPUT_ERROR,
+        PARSE_INVALID_SCHEMA,
+        PARSE_SCHEMA_MISMATCH
+    };
+
+    // switches of Reader, everything is off by default
+    struct Features {
+        // reject documents that are not well formed UTF-8 with PARSE_INVALID_UTF8
+        bool validateUtf8 = false;
+        // parse over the strings, elements and members already in the root Value
+        // instead of freeing them, documents of the same shape stop allocating;
+        // after an error the root is left half overwritten, a repeated key keeps its last value
+        bool reuseStorage = false;
+        // keep numbers as their source text, converted only when they are read and
+        // written out unchanged; the numbers share one copy of the document, so a
+        // single lazy number keeps that whole copy alive until Value::compact()
+        bool lazyNumbers = false;
     };
 
     enum json_type {
@@ -45,46 +99,166 @@ namespace JSON {
 
     class StyleWriter;
 
+    // containers and strings are shared between copies and copied on the first write,
+    // so copying a Value (or returning a member by value) is O(1)
     class Value {
     public:
+        typedef std::vector<Value> array_type;
+        // std::less<> lets members be looked up by const char* or string_view without a std::string
+        typedef std::map<std::string, Value, std::less<>> object_type;
+
+        // walks the elements of an array or the members of an object
+        template <bool Const>
+        class iterator_base {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef typename std::conditional<Const, const Value, Value>::type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef value_type* pointer;
+            typedef value_type& reference;
+            typedef typename std::conditional<Const, array_type::const_iterator, array_type::iterator>::type array_iterator;
+            typedef typename std::conditional<Const, object_type::const_iterator, object_type::iterator>::type object_iterator;
+
+            iterator_base() :is_array(true), at(), mt() {}
+
+            explicit iterator_base(array_iterator _at) :is_array(true), at(_at), mt() {}
+
+            explicit iterator_base(object_iterator _mt) :is_array(false), at(), mt(_mt) {}
+
+            reference operator*() const {
+                return is_array ? *at : mt->second;
+            }
+
+            pointer operator->() const {
+                return &operator*();
+            }
+
+            // key of the current member, empty for array elements
+            const std::string& name() const {
+                static const std::string empty_name;
+                return is_array ? empty_name : mt->first;
+            }
+
+            iterator_base& operator++() {
+                if (is_array)
+                    ++at;
+                else
+                    ++mt;
+                return *this;
+            }
+
+            iterator_base operator++(int) {
+                iterator_base tmp = *this;
+                operator++();
+                return tmp;
+            }
+
+            bool operator==(const iterator_base& other) const {
+                return is_array == other.is_array && (is_array ? at == other.at : mt == other.mt);
+            }
+
+            bool operator!=(const iterator_base& other) const {
+                return !(*this == other);
+            }
+        private:
+            bool is_array;
+            array_iterator at;
+            object_iterator mt;
+        };
+
+        typedef iterator_base<false> iterator;
+        typedef iterator_base<true> const_iterator;
+
         Value() :type(JSON_NULL) {}
 
         Value(const double value) :type(JSON_NUMBER), number(value) {}
 
-        Value(const char* value) :type(JSON_STRING), str(value) {}
+        Value(const char* value) :type(JSON_STRING), str(std::make_shared<std::string>(value)) {}
+
+        Value(const std::string& value) :type(JSON_STRING), str(std::make_shared<std::string>(value)) {}
 
-        Value(const std::string& value) :type(JSON_STRING), str(value) {}
+        Value(const std::string key, const Value value) :type(JSON_OBJECT), object(std::make_shared<object_type>()) {
+            object->insert(make_pair(key, value));
+        }
+
+        Value(const char *beginValue, const char *endValue)
+            :type(JSON_STRING), str(std::make_shared<std::string>(beginValue, endValue)) {}
 
-        Value(const std::string key, const Value value) :type(JSON_OBJECT) {
-            object.insert(make_pair(key, value));
+        // shares the payload of other, unless other handed out references into it
+        Value(const Value& other)
+            :type(other.type), comment(other.comment), number(other.number),
+            literal_offset(other.literal_offset), literal_length(other.literal_length),
+            str(other.str), hash_cache(other.hash_cache), hash_valid(other.hash_valid) {
+            share_payload(other);
         }
 
-        Value(const char *beginValue, const char *endValue) :type(JSON_STRING), str(beginValue, endValue) {}
+        // the moved-from value is left null, like after move assignment
+        Value(Value&& other)
+            :type(other.type), comment(std::move(other.comment)), number(other.number),
+            literal_offset(other.literal_offset), literal_length(other.literal_length),
+            str(std::move(other.str)), array(std::move(other.array)), packed(std::move(other.packed)),
+            object(std::move(other.object)), unshareable(other.unshareable),
+            hash_cache(other.hash_cache), hash_valid(other.hash_valid) {
+            other.type = JSON_NULL;
+            other.unshareable = false;
+            other.hash_valid = false;
+        }
 
         ~Value() {}
 
-        Value& operator[](const std::string key) {
-            if (type != JSON_OBJECT)
-                clear();
-            type = JSON_OBJECT;
-            return object[key];
+        // members can be named by std::string, const char* or (C++17) string_view,
+        // only inserting a new member allocates its key.
+        // Copies share their payload until one of them is written (copy on write).
+        // A reference from a non-const accessor (operator[], find, begin/end) points
+        // into this value's payload, so like the copy on write std::string, such a
+        // value stops sharing: later copies of it get a copy of that level and a
+        // write through the reference never shows up in them
+        Value& operator[](const std::string& key) {
+            return member(key);
+        }
+
+        // a missing member reads as null
+        const Value& operator[](const std::string& key) const {
+            const Value* found = find_member(key);
+            return found != nullptr ? *found : null_value();
+        }
+
+        // a template so that value[0] still picks the index overload
+        template <typename Char>
+        typename std::enable_if<std::is_same<Char, char>::value, Value&>::type operator[](const Char* key) {
+            return member(key);
+        }
+
+        template <typename Char>
+        typename std::enable_if<std::is_same<Char, char>::value, const Value&>::type operator[](const Char* key) const {
+            const Value* found = find_member(key);
+            return found != nullptr ? *found : null_value();
         }
 
-        const Value operator[](const std::string key) const {
-            auto mt = object.find(key);
-            if (mt != object.end())
-                return mt->second;
-            return Value();
+#if __cplusplus >= 201703L
+        Value& operator[](std::string_view key) {
+            return member(key);
         }
 
+        const Value& operator[](std::string_view key) const {
+            const Value* found = find_member(key);
+            return found != nullptr ? *found : null_value();
+        }
+#endif
+
+        // a packed array stays packed, the element comes from its expansion (see isPacked)
         Value& operator[](const size_t index) {
-            assert(type == JSON_ARRAY && index < array.size());
-            return array[index];
+            assert(type == JSON_ARRAY && index < array_size());
+            hash_valid = false;
+            unshareable = true;
+            if (packed)
+                return mutable_packed()[index];
+            return mutable_array()[index];
         }
 
         const Value& operator[](const size_t index) const {
-            assert(type == JSON_ARRAY && index < array.size());
-            return array[index];
+            assert(type == JSON_ARRAY && index < array_size());
+            return get_array()[index];
         }
 
         json_type get_type() const {
@@ -93,13 +267,39 @@ namespace JSON {
 
         double asDouble() const {
             assert(type == JSON_NUMBER);
-            return number;
+            return str ? strtod(str->data() + literal_offset, nullptr) : number;
+        }
+
+        // a kept integer literal is read exactly, also beyond the 53 bits of a double
+        long long asInt() const {
+            assert(type == JSON_NUMBER);
+            size_t length = 0;
+            const char* text = raw_number(length);
+            if (text != nullptr && std::find_if(text, text + length, [](char e) {
+                    return e == '.' || e == 'e' || e == 'E'; }) == text + length) {
+                errno = 0;
+                long long integer = strtoll(text, nullptr, 10);
+                if (errno != ERANGE)
+                    return integer;
+            }
+            return static_cast<long long>(asDouble());
+        }
+
+        // the source text of a number parsed with Features::lazyNumbers, empty otherwise
+        std::string getRawNumber() const {
+            size_t length = 0;
+            const char* text = raw_number(length);
+            return text != nullptr ? std::string(text, length) : std::string();
+        }
+
+        bool hasRawNumber() const {
+            return type == JSON_NUMBER && str != nullptr;
         }
 
         bool empty() {
             switch (type) {
-            case JSON_ARRAY: return array.empty();
-            case JSON_OBJECT: return object.empty();
+            case JSON_ARRAY: return array_size() == 0;
+            case JSON_OBJECT: return get_object().empty();
             default: return true;
             }
         }
@@ -107,8 +307,9 @@ namespace JSON {
         size_t size() const {
             assert(type == JSON_ARRAY || type == JSON_OBJECT);
             switch (type) {
-            case JSON_ARRAY: return array.size();
-            case JSON_OBJECT: return object.size();
+            case JSON_ARRAY: return array_size();
+            case JSON_OBJECT: return get_object().size();
+            default: return 0;
             }
         }
 
@@ -137,30 +338,165 @@ namespace JSON {
         }
 
         bool isValidIndex(const size_t index) const {
-            return index < array.size();
+            return index < array_size();
+        }
+
+        // an array of numbers only, kept as one contiguous block of doubles; the parser
+        // picks it by itself. Reading an element by reference builds a Value per number
+        // once and keeps them beside the doubles until compact(), numberAt() builds
+        // nothing. A non-const operator[] hands out those elements for writing, from
+        // then on the array is packed only while each of them is still a plain number;
+        // resize, append and non-const iteration unpack it
+        bool isPacked() const {
+            if (!packed)
+                return false;
+            if (!packed->exposed)
+                return true;
+            for (auto& e : packed->elements) {
+                if (!e.plain_number())
+                    return false;
+            }
+            return true;
+        }
+
+        // the numbers of a packed array, brought up to date with its elements when
+        // they were handed out for writing
+        const std::vector<double>& packedNumbers() const {
+            assert(isPacked());
+            packed_array& source = *packed;
+            if (source.exposed) {
+                std::lock_guard<std::mutex> lock(source.mtx);
+                for (size_t i = 0; i < source.numbers.size(); i++) {
+                    // written only when a number changed, concurrent readers see no store
+                    double number = source.elements[i].number;
+                    if (memcmp(&number, &source.numbers[i], sizeof(double)) != 0)
+                        source.numbers[i] = number;
+                }
+            }
+            return source.numbers;
+        }
+
+        // element index of an array of numbers, without building a Value for it
+        double numberAt(const size_t index) const {
+            assert(type == JSON_ARRAY && index < array_size());
+            if (packed && !packed->exposed)
+                return packed->numbers[index];
+            return get_array()[index].asDouble();
+        }
+
+        void setNumbers(std::vector<double> numbers) {
+            clear();
+            type = JSON_ARRAY;
+            packed = std::make_shared<packed_array>();
+            packed->numbers = std::move(numbers);
+        }
+
+        bool isMember(const std::string& key) const {
+            return find_member(key) != nullptr;
+        }
+
+        bool isMember(const char* key) const {
+            return find_member(key) != nullptr;
+        }
+
+        // the member, nullptr if there is none or this is not an object
+        const Value* find(const std::string& key) const {
+            return find_member(key);
+        }
+
+        const Value* find(const char* key) const {
+            return find_member(key);
+        }
+
+        Value* find(const std::string& key) {
+            return find_mutable_member(key);
+        }
+
+        Value* find(const char* key) {
+            return find_mutable_member(key);
+        }
+
+#if __cplusplus >= 201703L
+        bool isMember(std::string_view key) const {
+            return find_member(key) != nullptr;
+        }
+
+        const Value* find(std::string_view key) const {
+            return find_member(key);
+        }
+
+        Value* find(std::string_view key) {
+            return find_mutable_member(key);
+        }
+#endif
+
+        // the member, or default_value if there is none
+        Value get(const std::string& key, const Value& default_value) const {
+            const Value* found = find_member(key);
+            return found != nullptr ? *found : default_value;
+        }
+
+        Value get(const char* key, const Value& default_value) const {
+            const Value* found = find_member(key);
+            return found != nullptr ? *found : default_value;
+        }
+
+        iterator begin() {
+            hash_valid = false;
+            unshareable = type == JSON_ARRAY || type == JSON_OBJECT || unshareable;
+            switch (type) {
+            case JSON_ARRAY: return iterator(mutable_array().begin());
+            case JSON_OBJECT: return iterator(mutable_object().begin());
+            default: return iterator();
+            }
+        }
+
+        iterator end() {
+            hash_valid = false;
+            unshareable = type == JSON_ARRAY || type == JSON_OBJECT || unshareable;
+            switch (type) {
+            case JSON_ARRAY: return iterator(mutable_array().end());
+            case JSON_OBJECT: return iterator(mutable_object().end());
+            default: return iterator();
+            }
         }
 
-        bool isMember(std::string key) const {
-            return object.find(key) != object.end();
+        const_iterator begin() const {
+            switch (type) {
+            case JSON_ARRAY: return const_iterator(get_array().begin());
+            case JSON_OBJECT: return const_iterator(get_object().begin());
+            default: return const_iterator();
+            }
         }
 
-        Value get(const std::string key, const Value default_value) const {
-            return Value(key, default_value);
+        const_iterator end() const {
+            switch (type) {
+            case JSON_ARRAY: return const_iterator(get_array().end());
+            case JSON_OBJECT: return const_iterator(get_object().end());
+            default: return const_iterator();
+            }
         }
 
         std::vector<std::string> getMemberNames() const {
             assert(type == JSON_OBJECT);
             std::vector<std::string> names;
-            for (auto e : object) {
+            names.reserve(get_object().size());
+            for (auto& e : get_object()) {
                 names.push_back(e.first);
             }
             return names;
         }
 
-        Value removeMember(const std::string key) {
-            std::map<std::string, Value>::iterator mt = object.find(key);
-            if (mt != object.end())
-                object.erase(mt);
+        Value removeMember(const std::string& key) {
+            return removeMember(key.c_str());
+        }
+
+        Value removeMember(const char* key) {
+            if (find_member(key) != nullptr) {
+                object_type& members = mutable_object();
+                members.erase(members.find(key));
+            }
+            hash_valid = false;
             return *this;
         }
 
@@ -177,27 +513,28 @@ namespace JSON {
         }
 
         void clear() {
-            switch (type) {
-            case JSON_STRING: str.clear(); break;
-            case JSON_ARRAY: array.clear(); break;
-            case JSON_OBJECT: object.clear(); break;
-            }
+            str.reset();
+            array.reset();
+            packed.reset();
+            object.reset();
+            unshareable = false;
             type = JSON_NULL;
+            hash_valid = false;
         }
 
         void resize(size_t size) {
             assert(type == JSON_ARRAY || type == JSON_OBJECT);
+            hash_valid = false;
             switch (type) {
-            case JSON_ARRAY: array.resize(size); break;
+            case JSON_ARRAY: mutable_array().resize(size); break;
             case JSON_OBJECT:
-                if (object.size() > size) {
-                    size_t delete_size = object.size() - size;
-                    for (delete_size; delete_size > 0; delete_size--) {
-                        auto mt = object.rbegin();
-                        object.erase(mt->first);
-                    }
+                if (get_object().size() > size) {
+                    object_type& members = mutable_object();
+                    while (members.size() > size)
+                        members.erase(std::prev(members.end()));
                 }
                 break;
+            default: break;
             }
         }
 
@@ -218,419 +555,4056 @@ namespace JSON {
         void operator=(const char* dst_str) {
             clear();
             type = JSON_STRING;
-            str = std::string(dst_str);
+            str = std::make_shared<std::string>(dst_str);
         }
 
         void operator=(const std::string& dst_str) {
             clear();
             type = JSON_STRING;
-            str = dst_str;
+            str = std::make_shared<std::string>(dst_str);
+        }
+
+        void operator=(std::string&& dst_str) {
+            clear();
+            type = JSON_STRING;
+            str = std::make_shared<std::string>(std::move(dst_str));
+        }
+
+        void operator=(const array_type& dst_array) {
+            clear();
+            type = JSON_ARRAY;
+            array = std::make_shared<array_type>(dst_array);
         }
 
-        void operator=(const std::vector<Value>& dst_array) {
+        void operator=(array_type&& dst_array) {
             clear();
             type = JSON_ARRAY;
-            array = dst_array;
+            array = std::make_shared<array_type>(std::move(dst_array));
+        }
+
+        void operator=(const object_type& dst_object) {
+            clear();
+            type = JSON_OBJECT;
+            object = std::make_shared<object_type>(dst_object);
+        }
+
+        void operator=(object_type&& dst_object) {
+            clear();
+            type = JSON_OBJECT;
+            object = std::make_shared<object_type>(std::move(dst_object));
         }
 
         void operator=(const std::map<std::string, Value>& dst_object) {
             clear();
             type = JSON_OBJECT;
-            object = dst_object;
+            object = std::make_shared<object_type>(dst_object.begin(), dst_object.end());
         }
 
+        // shares the payload of other, nothing below is copied (see operator[])
         void operator=(const Value& other) {
-            switch (other.get_type()) {
-            case JSON_NULL: clear(); break;
-            case JSON_TRUE: operator=(true); break;
-            case JSON_FALSE: operator=(false); break;
-            case JSON_NUMBER: operator=(other.asDouble()); break;
+            if (this == &other)
+                return;
+            type = other.type;
+            number = other.number;
+            literal_offset = other.literal_offset;
+            literal_length = other.literal_length;
+            str = other.str;
+            share_payload(other);
+            hash_cache = other.hash_cache;
+            hash_valid = other.hash_valid;
+        }
+
+        void operator=(Value&& other) {
+            if (this == &other)
+                return;
+            type = other.type;
+            number = other.number;
+            literal_offset = other.literal_offset;
+            literal_length = other.literal_length;
+            str = std::move(other.str);
+            array = std::move(other.array);
+            packed = std::move(other.packed);
+            object = std::move(other.object);
+            unshareable = other.unshareable;
+            hash_cache = other.hash_cache;
+            hash_valid = other.hash_valid;
+            other.type = JSON_NULL;
+            other.unshareable = false;
+            other.hash_valid = false;
+        }
+
+        void append(const Value& value) {
+            hash_valid = false;
+            switch (type) {
             case JSON_ARRAY:
-                clear();
-                for (size_t i = 0; i < other.size(); i++)
-                    array.push_back(other[i]);
+                mutable_array().push_back(value);
                 break;
-            case JSON_OBJECT:
-                std::vector<std::string> names = other.getMemberNames();
-                for (auto it : names)
-                    object.insert(make_pair(it, other[it]));
+            case JSON_OBJECT: {
+                assert(value.get_type() == JSON_OBJECT);
+                object_type& members = mutable_object();
+                for (auto& e : value.get_object())
+                    members.insert(e);
                 break;
             }
+            default: break;
+            }
         }
 
-        void append(const Value& value) {
+        // deep compare, comments are not part of the value
+        bool operator==(const Value& other) const {
+            if (this == &other)
+                return true;
+            if (type != other.type)
+                return false;
+            switch (type) {
+            case JSON_NUMBER: return asDouble() == other.asDouble();
+            case JSON_STRING: return str == other.str || *str == *other.str;
+            case JSON_ARRAY: {
+                // a shared payload is equal without looking into it
+                if (array == other.array && packed == other.packed)
+                    return true;
+                if (isPacked() && other.isPacked())
+                    return packedNumbers() == other.packedNumbers();
+                const array_type& elements = get_array();
+                const array_type& other_elements = other.get_array();
+                if (elements.size() != other_elements.size())
+                    return false;
+                for (size_t i = 0; i < elements.size(); i++) {
+                    if (!(elements[i] == other_elements[i]))
+                        return false;
+                }
+                return true;
+            }
+            case JSON_OBJECT: {
+                if (object == other.object)
+                    return true;
+                const object_type& members = get_object();
+                const object_type& other_members = other.get_object();
+                if (members.size() != other_members.size())
+                    return false;
+                auto ot = other_members.begin();
+                for (auto mt = members.begin(); mt != members.end(); mt++, ot++) {
+                    if (mt->first != ot->first || !(mt->second == ot->second))
+                        return false;
+                }
+                return true;
+            }
+            default: return true;
+            }
+        }
+
+        bool operator!=(const Value& other) const {
+            return !(*this == other);
+        }
+
+        // structural hash, cached until this value is changed through its own interface;
+        // a write through a held child reference leaves the cache of its ancestors stale
+        size_t hash() const {
+            if (hash_valid)
+                return hash_cache;
+            bool cached = type == JSON_STRING || type == JSON_ARRAY || type == JSON_OBJECT;
+            size_t h = static_cast<size_t>(type) + 0x9e3779b9;
             switch (type) {
+            case JSON_NUMBER:
+                h = number_hash(asDouble());
+                break;
+            case JSON_STRING:
+                hash_combine(h, std::hash<std::string>()(*str));
+                break;
             case JSON_ARRAY:
-                array.push_back(value);
+                if (isPacked()) {
+                    // the same as the elements would hash to, without building them
+                    for (auto e : packedNumbers())
+                        hash_combine(h, number_hash(e));
+                    break;
+                }
+                for (auto& e : get_array())
+                    hash_combine(h, e.hash());
                 break;
             case JSON_OBJECT:
-                assert(value.get_type() == JSON_OBJECT);
-                std::vector<std::string> names = value.getMemberNames();
-                for (auto vt : names)
-                    object.insert(make_pair(vt, value[vt]));
+                for (auto& e : get_object()) {
+                    hash_combine(h, std::hash<std::string>()(e.first));
+                    hash_combine(h, e.second.hash());
+                }
                 break;
+            default: break;
             }
+            if (cached) {
+                hash_cache = h;
+                hash_valid = true;
+            }
+            return h;
         }
 
         std::string toStyledString() const;
 
         std::string asString() const;
+
+        // lay the tree out again after heavy mutation: every container and string is
+        // reallocated exactly sized in depth first order, equal strings share one
+        // payload, lazy numbers move into one buffer of their literals (releasing the
+        // document they came from) and payloads shared inside the tree stay shared
+        void compact();
     private:
-        json_type type;
-        std::string comment;
-        double number;
-        std::string str;
-        std::vector<Value> array;
-        std::map<std::string, Value> object;
-        FastWriter* fw;
-        StyleWriter* sw;
-    };
+        static void hash_combine(size_t& seed, size_t h) {
+            seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
 
-    class value_parse {
-    public:
-        void set_json_source(const std::string& source, Value* value) {
-            json_source = source;
-            it = json_source.begin();
-            root = value;
+        const char* raw_number(size_t& length) const {
+            if (!hasRawNumber())
+                return nullptr;
+            length = literal_length;
+            return str->data() + literal_offset;
         }
 
-        int parse()
-        {
-            skip_blank();
-            int ret = 0;
-            if ((ret = parse_value()) == PARSE_OK) {
-                skip_blank();
-                if (it != json_source.end()) {
-                    root->clear();
-                    return PARSE_ROOT_NOT_SINGULAR;
-                }
-            }
-            return ret;
+        // a number that is literal_length bytes of source from literal_offset on
+        void set_raw_number(const std::shared_ptr<std::string>& source, size_t offset, size_t length) {
+            clear();
+            type = JSON_NUMBER;
+            str = source;
+            literal_offset = static_cast<uint32_t>(offset);
+            literal_length = static_cast<uint32_t>(length);
         }
-    private:
-        int parse_value(Value* element = nullptr) {
-            if (it == json_source.end())
-                return PARSE_EXPECT_VALUE;
-            switch (*it) {
-            case 'n': return parse_literal("null", JSON_NULL, element);
-            case 't': return parse_literal("true", JSON_TRUE, element);
-            case 'f': return parse_literal("false", JSON_FALSE, element);
-            case '[': return parse_array(element);
-            case '{': return parse_object(element);
-            case '\"': return parse_string(element);
-            case '\0': return PARSE_EXPECT_VALUE;
-            default:
-                if (*it == '-' || (*it >= '0' && *it <= '9')) {
-                    return parse_number(element);
-                }
-                return PARSE_INVALID_VALUE;
+
+        static size_t number_hash(double number) {
+            size_t h = static_cast<size_t>(JSON_NUMBER) + 0x9e3779b9;
+            // 0.0 == -0.0, so they must hash the same
+            hash_combine(h, std::hash<double>()(number == 0 ? 0.0 : number));
+            return h;
+        }
+
+        // a packed array builds its elements once, on the first read by reference
+        const array_type& get_array() const {
+            static const array_type empty_array;
+            if (packed) {
+                packed_array& source = *packed;
+                std::call_once(source.once, [&source]() {
+                    source.elements.assign(source.numbers.begin(), source.numbers.end());
+                    source.expanded = true;
+                });
+                return source.elements;
             }
+            return array ? *array : empty_array;
         }
 
-        void skip_blank() {
-            while (it != json_source.end() && *it == ' ')
-                it++;
+        size_t array_size() const {
+            return packed ? packed->numbers.size() : get_array().size();
         }
 
-        int parse_literal(const char* dst, json_type type, Value* element = nullptr) {
-            int len = strlen(dst);
-            if (strncmp(&(*it), dst, len) == 0) {
-                it += len;
-                if (element != nullptr) {
-                    switch (type) {
-                    case JSON_NULL: element->clear(); break;
-                    case JSON_TRUE: *element = true; break;
-                    case JSON_FALSE: *element = false; break;
-                    }
-                }
-                else {
-                    switch (type) {
-                    case JSON_NULL: root->clear(); break;
-                    case JSON_TRUE: *root = true; break;
-                    case JSON_FALSE: *root = false; break;
-                    }
-                }
-                return PARSE_OK;
-            }
-            else
-                return PARSE_INVALID_VALUE;
+        const object_type& get_object() const {
+            static const object_type empty_object;
+            return object ? *object : empty_object;
         }
 
-#define ISDIGIT(num) ((num >= '0') && (num <= '9'))
-#define ISDIGIT1TO9(num) ((num >= '1') && (num <= '9'))
+        static const Value& null_value() {
+            static const Value null;
+            return null;
+        }
 
-        int parse_number(Value* element = nullptr) {
-            std::string::const_iterator tmp_it = it;
-            if (*tmp_it == '-')
-                tmp_it++;
-            if (*tmp_it == '0')
-                tmp_it++;
-            else {
-                if (!ISDIGIT1TO9(*tmp_it))
-                    return PARSE_INVALID_VALUE;
-                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
-            }
-            if (*tmp_it == '.') {
-                tmp_it++;
-                if (!ISDIGIT(*tmp_it))
-                    return PARSE_INVALID_VALUE;
-                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
-            }
-            if (*tmp_it == 'e' || *tmp_it == 'E') {
-                tmp_it++;
-                if (*tmp_it == '-' || *tmp_it == '+')
-                    tmp_it++;
-                if (!ISDIGIT(*tmp_it))
-                    return PARSE_INVALID_VALUE;
-                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
-            }
-            // if (*tmp_it != ' ' && *tmp_it != '\0')
-            //    return PARSE_INVALID_VALUE;
-            double dst_number = strtod(&(*it), NULL);
-            if (errno == ERANGE && (dst_number == HUGE_VAL || dst_number == -HUGE_VAL))
-                return PARSE_NUMBER_OVERFLOW;
-            it = tmp_it;
-            if (element != nullptr)
-                *element = dst_number;
-            else
-                *root = dst_number;
-            return PARSE_OK;
+        template <typename Key>
+        const Value* find_member(const Key& key) const {
+            if (type != JSON_OBJECT || !object)
+                return nullptr;
+            auto mt = object->find(key);
+            return mt != object->end() ? &mt->second : nullptr;
         }
 
-#define CHECK_ITERATOR(it) do { if (it == json_source.end()) return PARSE_MISS_QUOTATION_MARK; } while(0)
+        template <typename Key>
+        Value* find_mutable_member(const Key& key) {
+            if (find_member(key) == nullptr)
+                return nullptr;
+            hash_valid = false;
+            unshareable = true;
+            return &mutable_object().find(key)->second;
+        }
 
-        int parse_string(Value* element = nullptr) {
-            std::string tmp_str;
-            std::string::const_iterator tmp_it = it;
-            int ret = parse_string(tmp_str, tmp_it);
-            if (ret == PARSE_OK) {
-                it = tmp_it;
-                if (element != nullptr)
-                    *element = tmp_str;
+        template <typename Key>
+        Value& member(const Key& key) {
+            if (type != JSON_OBJECT)
+                clear();
+            type = JSON_OBJECT;
+            hash_valid = false;
+            unshareable = true;
+            object_type& members = mutable_object();
+            auto mt = members.lower_bound(key);
+            if (mt == members.end() || members.key_comp()(key, mt->first))
+                mt = members.emplace_hint(mt, std::string(key), Value());
+            return mt->second;
+        }
+
+        bool plain_number() const {
+            return type == JSON_NUMBER && !str && comment.empty();
+        }
+
+        // the payload of other, copied one level down when other handed out
+        // references into it
+        void share_payload(const Value& other) {
+            unshareable = false;
+            if (!other.unshareable) {
+                array = other.array;
+                packed = other.packed;
+                object = other.object;
+                return;
+            }
+            array = other.array ? std::make_shared<array_type>(*other.array) : nullptr;
+            packed = other.packed ? copy_packed(*other.packed) : nullptr;
+            object = other.object ? std::make_shared<object_type>(*other.object) : nullptr;
+        }
+
+        struct packed_array;
+
+        // the elements are copied only when they were handed out for writing
+        static std::shared_ptr<packed_array> copy_packed(const packed_array& source) {
+            auto copy = std::make_shared<packed_array>();
+            if (!source.exposed) {
+                copy->numbers = source.numbers;
+                return copy;
+            }
+            copy->elements = source.elements;
+            for (auto& e : copy->elements)
+                copy->numbers.push_back(e.number);
+            std::call_once(copy->once, []() {});
+            copy->expanded = true;
+            copy->exposed = true;
+            return copy;
+        }
+
+        // the elements of a packed array open for writing, a shared one is copied first
+        array_type& mutable_packed() {
+            if (packed.use_count() > 1)
+                packed = copy_packed(*packed);
+            get_array();
+            packed->exposed = true;
+            return packed->elements;
+        }
+
+        // detach from the other owners before the first write
+        array_type& mutable_array() {
+            if (packed) {
+                if (packed->exposed)
+                    array = std::make_shared<array_type>(packed->elements);
+                else
+                    array = std::make_shared<array_type>(packed->numbers.begin(), packed->numbers.end());
+                packed.reset();
+            }
+            else if (!array)
+                array = std::make_shared<array_type>();
+            else if (array.use_count() > 1)
+                array = std::make_shared<array_type>(*array);
+            return *array;
+        }
+
+        object_type& mutable_object() {
+            if (!object)
+                object = std::make_shared<object_type>();
+            else if (object.use_count() > 1)
+                object = std::make_shared<object_type>(*object);
+            return *object;
+        }
+
+        // storage the parser overwrites in place, a fresh one when it is shared
+        std::string& reuse_string() {
+            if (type != JSON_STRING || str.use_count() != 1) {
+                clear();
+                type = JSON_STRING;
+                str = std::make_shared<std::string>();
+            }
+            hash_valid = false;
+            str->clear();
+            return *str;
+        }
+
+        array_type& reuse_array() {
+            if (type != JSON_ARRAY || array.use_count() != 1) {
+                clear();
+                type = JSON_ARRAY;
+                array = std::make_shared<array_type>();
+            }
+            hash_valid = false;
+            return *array;
+        }
+
+        // a packed array that already built its elements cannot be refilled in place
+        std::vector<double>& reuse_numbers() {
+            if (type != JSON_ARRAY || packed.use_count() != 1 || packed->expanded)
+                setNumbers(std::vector<double>());
+            hash_valid = false;
+            packed->numbers.clear();
+            return packed->numbers;
+        }
+
+        object_type& reuse_object() {
+            if (type != JSON_OBJECT || object.use_count() != 1) {
+                clear();
+                type = JSON_OBJECT;
+                object = std::make_shared<object_type>();
+            }
+            hash_valid = false;
+            return *object;
+        }
+
+        friend class value_diff;
+
+        friend class value_parse;
+
+        friend class value_compact;
+
+        friend class Writer;
+
+        friend class StreamWriter;
+
+        struct packed_array {
+            std::vector<double> numbers;
+            std::once_flag once;
+            array_type elements;
+            bool expanded = false;
+            // elements were handed out for writing and are ahead of numbers
+            bool exposed = false;
+            std::mutex mtx;
+        };
+
+        json_type type;
+        std::string comment;
+        double number;
+        // a lazy number points into the document held by str
+        uint32_t literal_offset = 0;
+        uint32_t literal_length = 0;
+        std::shared_ptr<std::string> str;
+        std::shared_ptr<array_type> array;
+        std::shared_ptr<packed_array> packed;
+        std::shared_ptr<object_type> object;
+        // a non-const accessor handed out a reference into the payload
+        bool unshareable = false;
+        mutable size_t hash_cache = 0;
+        mutable bool hash_valid = false;
+    };
+
+    // JSON Pointer (RFC 6901) escaping of a key
+    inline std::string escape_pointer(const std::string& key) {
+        std::string tmp_str;
+        for (auto e : key) {
+            switch (e) {
+            case '~': tmp_str += "~0"; break;
+            case '/': tmp_str += "~1"; break;
+            default: tmp_str += e; break;
+            }
+        }
+        return tmp_str;
+    }
+
+    // build a JSON Patch (RFC 6902) that turns source into target
+    class value_diff {
+    public:
+        Value diff(const Value& source, const Value& target) {
+            patch = std::vector<Value>();
+            diff_value(std::string(), source, target);
+            return patch;
+        }
+    private:
+        void diff_value(const std::string& path, const Value& source, const Value& target) {
+            // identical subtrees are dropped by their hash, == only guards against collisions
+            if (source.hash() == target.hash() && source == target)
+                return;
+            if (source.type != target.type || (source.type != JSON_ARRAY && source.type != JSON_OBJECT)) {
+                add_operation("replace", path, &target);
+                return;
+            }
+            if (source.type == JSON_ARRAY) {
+                const Value::array_type& source_array = source.get_array();
+                const Value::array_type& target_array = target.get_array();
+                size_t common = std::min(source_array.size(), target_array.size());
+                for (size_t i = 0; i < common; i++)
+                    diff_value(path + '/' + std::to_string(i), source_array[i], target_array[i]);
+                for (size_t i = common; i < target_array.size(); i++)
+                    add_operation("add", path + '/' + std::to_string(i), &target_array[i]);
+                // remove from the back so the earlier indexes stay valid
+                for (size_t i = source_array.size(); i > common; i--)
+                    add_operation("remove", path + '/' + std::to_string(i - 1), nullptr);
+                return;
+            }
+            // both maps are sorted, walk them side by side
+            const Value::object_type& source_object = source.get_object();
+            const Value::object_type& target_object = target.get_object();
+            auto st = source_object.begin();
+            auto tt = target_object.begin();
+            while (st != source_object.end() || tt != target_object.end()) {
+                if (tt == target_object.end() || (st != source_object.end() && st->first < tt->first)) {
+                    add_operation("remove", path + '/' + escape_pointer(st->first), nullptr);
+                    st++;
+                }
+                else if (st == source_object.end() || tt->first < st->first) {
+                    add_operation("add", path + '/' + escape_pointer(tt->first), &tt->second);
+                    tt++;
+                }
+                else {
+                    diff_value(path + '/' + escape_pointer(st->first), st->second, tt->second);
+                    st++;
+                    tt++;
+                }
+            }
+        }
+
+        void add_operation(const char* op, const std::string& path, const Value* value) {
+            Value operation;
+            operation["op"] = op;
+            operation["path"] = path;
+            if (value != nullptr)
+                operation["value"] = *value;
+            patch.append(operation);
+        }
+    private:
+        Value patch;
+    };
+
+    inline Value diff(const Value& source, const Value& target) {
+        value_diff differ;
+        return differ.diff(source, target);
+    }
+
+    class value_compact {
+    public:
+        void compact(Value& root) {
+            literals = std::make_shared<std::string>();
+            compact_value(root);
+            literals->shrink_to_fit();
+        }
+    private:
+        struct text_hash {
+            size_t operator()(const std::shared_ptr<std::string>& text) const {
+                return std::hash<std::string>()(*text);
+            }
+        };
+
+        struct text_equal {
+            bool operator()(const std::shared_ptr<std::string>& a, const std::shared_ptr<std::string>& b) const {
+                return *a == *b;
+            }
+        };
+
+        void compact_value(Value& value) {
+            value.comment.shrink_to_fit();
+            switch (value.type) {
+            case JSON_NUMBER: compact_number(value); break;
+            case JSON_STRING: {
+                auto found = strings.find(value.str);
+                if (found != strings.end())
+                    value.str = *found;
+                else {
+                    value.str = std::make_shared<std::string>(*value.str);
+                    strings.insert(value.str);
+                }
+                break;
+            }
+            case JSON_ARRAY:
+                if (value.packed && !value.isPacked()) {
+                    value.array = std::make_shared<Value::array_type>(value.packed->elements);
+                    value.packed.reset();
+                }
+                if (value.packed)
+                    value.packed = compact_packed(value.packed);
+                else if (value.array)
+                    value.array = compact_array(value.array);
+                break;
+            case JSON_OBJECT:
+                if (value.object)
+                    value.object = compact_object(value.object);
+                break;
+            default: break;
+            }
+        }
+
+        void compact_number(Value& value) {
+            size_t length = 0;
+            const char* text = value.raw_number(length);
+            if (text == nullptr)
+                return;
+            size_t offset = literals->size();
+            if (offset + length >= UINT32_MAX) {
+                value.number = value.asDouble();
+                value.str.reset();
+                return;
+            }
+            // the space stops strtod at the end of the literal
+            literals->append(text, length);
+            *literals += ' ';
+            value.str = literals;
+            value.literal_offset = static_cast<uint32_t>(offset);
+        }
+
+        std::shared_ptr<Value::array_type> compact_array(const std::shared_ptr<Value::array_type>& source) {
+            auto found = arrays.find(source.get());
+            if (found != arrays.end())
+                return found->second;
+            auto elements = std::make_shared<Value::array_type>();
+            elements->reserve(source->size());
+            for (auto& e : *source) {
+                elements->push_back(e);
+                compact_value(elements->back());
+            }
+            arrays.emplace(source.get(), elements);
+            return elements;
+        }
+
+        std::shared_ptr<Value::object_type> compact_object(const std::shared_ptr<Value::object_type>& source) {
+            auto found = objects.find(source.get());
+            if (found != objects.end())
+                return found->second;
+            auto members = std::make_shared<Value::object_type>();
+            for (auto& e : *source) {
+                auto mt = members->emplace_hint(members->end(), e.first, e.second);
+                compact_value(mt->second);
+            }
+            objects.emplace(source.get(), members);
+            return members;
+        }
+
+        std::shared_ptr<Value::packed_array> compact_packed(const std::shared_ptr<Value::packed_array>& source) {
+            auto found = packs.find(source.get());
+            if (found != packs.end())
+                return found->second;
+            auto numbers = std::make_shared<Value::packed_array>();
+            // the copy holds the doubles only, elements built for reading are dropped
+            if (source->exposed) {
+                for (auto& e : source->elements)
+                    numbers->numbers.push_back(e.number);
+            }
+            else
+                numbers->numbers = source->numbers;
+            packs.emplace(source.get(), numbers);
+            return numbers;
+        }
+
+        std::shared_ptr<std::string> literals;
+        std::unordered_set<std::shared_ptr<std::string>, text_hash, text_equal> strings;
+        // old payload to its copy, the old tree keeps every key alive until the end
+        std::unordered_map<const void*, std::shared_ptr<Value::array_type>> arrays;
+        std::unordered_map<const void*, std::shared_ptr<Value::object_type>> objects;
+        std::unordered_map<const void*, std::shared_ptr<Value::packed_array>> packs;
+    };
+
+    inline void Value::compact() {
+        value_compact().compact(*this);
+    }
+
+    // an immutable tree: every lazily computed cache is filled before it is shared, so
+    // any number of threads can read it through const access without a lock
+    class FrozenDocument {
+    public:
+        explicit FrozenDocument(Value _root) :root(std::move(_root)) {
+            root.hash();
+        }
+
+        FrozenDocument(const FrozenDocument&) = delete;
+
+        FrozenDocument& operator=(const FrozenDocument&) = delete;
+
+        const Value& get() const {
+            return root;
+        }
+
+        const Value& operator*() const {
+            return root;
+        }
+
+        const Value* operator->() const {
+            return &root;
+        }
+    private:
+        const Value root;
+    };
+
+    // publishes FrozenDocument versions to reader threads with epoch based reclamation:
+    // readers announce the epoch they entered in and never block, publish() swaps the
+    // pointer and frees the old versions once no reader can still see them
+    class DocumentPublisher {
+    private:
+        // one per reader, padded so readers do not share a cache line
+        struct reader_slot {
+            std::atomic<unsigned long long> epoch{ 0 };
+            std::atomic<bool> used{ false };
+            char padding[64 - sizeof(std::atomic<unsigned long long>) - sizeof(std::atomic<bool>)];
+        };
+
+        // slots come in blocks, a new block is linked in when every slot is taken
+        // and stays until the publisher goes
+        struct slot_block {
+            explicit slot_block(size_t _count) :slots(new reader_slot[_count]), count(_count) {}
+
+            std::unique_ptr<reader_slot[]> slots;
+            size_t count;
+            std::atomic<slot_block*> next{ nullptr };
+        };
+    public:
+        class View;
+
+        // a registered reader, keep one per thread; there is no limit on sessions,
+        // more than max_readers at once only make publish() scan more slots
+        class Session {
+        public:
+            explicit Session(DocumentPublisher& _publisher) :publisher(_publisher) {
+                slot = publisher.take_slot();
+            }
+
+            ~Session() {
+                assert(depth == 0);
+                slot->used.store(false);
+            }
+
+            Session(const Session&) = delete;
+
+            Session& operator=(const Session&) = delete;
+
+            // the current version, valid while the View lives
+            View read() {
+                return View(*this);
+            }
+        private:
+            friend class View;
+
+            const FrozenDocument* enter() {
+                if (depth++ == 0)
+                    slot->epoch.store(publisher.epoch.load());
+                return publisher.current.load();
+            }
+
+            void leave() {
+                if (--depth == 0)
+                    slot->epoch.store(0);
+            }
+        private:
+            DocumentPublisher& publisher;
+            reader_slot* slot = nullptr;
+            size_t depth = 0;
+        };
+
+        class View {
+        public:
+            View(const View&) = delete;
+
+            View& operator=(const View&) = delete;
+
+            View(View&& other) :session(other.session), document(other.document) {
+                other.session = nullptr;
+            }
+
+            ~View() {
+                if (session != nullptr)
+                    session->leave();
+            }
+
+            // nullptr before the first publish()
+            const FrozenDocument* get() const {
+                return document;
+            }
+
+            const Value& operator*() const {
+                return document->get();
+            }
+
+            const Value* operator->() const {
+                return &document->get();
+            }
+        private:
+            friend class Session;
+
+            explicit View(Session& _session) :session(&_session), document(_session.enter()) {}
+        private:
+            Session* session;
+            const FrozenDocument* document;
+        };
+
+        // max_readers slots are made up front, later ones in blocks of that size
+        explicit DocumentPublisher(size_t max_readers = 64) :first(max_readers == 0 ? 1 : max_readers) {}
+
+        // every Session must be gone
+        ~DocumentPublisher() {
+            delete current.load();
+            for (auto& e : retired)
+                delete e.second;
+            slot_block* block = first.next.load();
+            while (block != nullptr) {
+                slot_block* next = block->next.load();
+                delete block;
+                block = next;
+            }
+        }
+
+        DocumentPublisher(const DocumentPublisher&) = delete;
+
+        DocumentPublisher& operator=(const DocumentPublisher&) = delete;
+
+        // freeze root and make it the version new readers see
+        void publish(Value root) {
+            const FrozenDocument* document = new FrozenDocument(std::move(root));
+            std::lock_guard<std::mutex> lock(mtx);
+            const FrozenDocument* old = current.exchange(document);
+            // readers that entered before the increment may still hold old
+            unsigned long long retired_epoch = epoch.fetch_add(1);
+            if (old != nullptr)
+                retired.push_back(std::make_pair(retired_epoch, old));
+            collect();
+        }
+
+        // free the old versions no reader can see any more, publish() does it too
+        void reclaim() {
+            std::lock_guard<std::mutex> lock(mtx);
+            collect();
+        }
+
+        // old versions still waiting for their readers
+        size_t retiredCount() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return retired.size();
+        }
+    private:
+        // a free slot, a new block is added under the lock when all are taken
+        reader_slot* take_slot() {
+            for (;;) {
+                slot_block* last = &first;
+                for (slot_block* block = &first; block != nullptr; block = block->next.load()) {
+                    for (size_t i = 0; i < block->count; i++) {
+                        bool expected = false;
+                        if (block->slots[i].used.compare_exchange_strong(expected, true))
+                            return &block->slots[i];
+                    }
+                    last = block;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                // another session may have grown the table meanwhile, then scan again
+                if (last->next.load() == nullptr)
+                    last->next.store(new slot_block(first.count));
+            }
+        }
+
+        void collect() {
+            unsigned long long oldest = std::numeric_limits<unsigned long long>::max();
+            for (slot_block* block = &first; block != nullptr; block = block->next.load()) {
+                for (size_t i = 0; i < block->count; i++) {
+                    unsigned long long entered = block->slots[i].epoch.load();
+                    if (entered != 0)
+                        oldest = std::min(oldest, entered);
+                }
+            }
+            auto end = std::remove_if(retired.begin(), retired.end(),
+                [oldest](const std::pair<unsigned long long, const FrozenDocument*>& e) {
+                    if (e.first >= oldest)
+                        return false;
+                    delete e.second;
+                    return true;
+                });
+            retired.erase(end, retired.end());
+        }
+    private:
+        slot_block first;
+        std::atomic<const FrozenDocument*> current{ nullptr };
+        // 0 marks an idle reader
+        std::atomic<unsigned long long> epoch{ 1 };
+        std::mutex mtx;
+        std::vector<std::pair<unsigned long long, const FrozenDocument*>> retired;
+    };
+
+    // one compiled schema, children are indexes into Schema::rules, -1 accepts anything
+    struct schema_rule {
+        // bit (1 << json_type) per accepted type, 0 accepts every type
+        unsigned types = 0;
+        bool integer = false;
+        // the schema false, nothing matches
+        bool never = false;
+        // inclusive and exclusive bounds are kept apart, a schema may give both
+        bool has_minimum = false, has_maximum = false;
+        bool has_exclusive_minimum = false, has_exclusive_maximum = false;
+        double minimum = 0, maximum = 0;
+        double exclusive_minimum = 0, exclusive_maximum = 0;
+        size_t min_length = 0, max_length = std::numeric_limits<size_t>::max();
+        size_t min_items = 0, max_items = std::numeric_limits<size_t>::max();
+        bool has_enum = false;
+        std::vector<Value> enumeration;
+        int items = -1;
+        std::map<std::string, int, std::less<>> properties;
+        std::vector<std::string> required;
+        bool additional = true;
+        int additional_rule = -1;
+    };
+
+    class value_parse;
+
+    // subset of JSON Schema (type, required, properties, additionalProperties, items,
+    // enum, minimum/maximum, exclusiveMinimum/exclusiveMaximum, minLength/maxLength,
+    // minItems/maxItems) compiled once and checked by the parser while it reads
+    class Schema {
+    public:
+        // an empty schema accepts every document
+        Schema() {}
+
+        // PARSE_INVALID_SCHEMA for a malformed keyword, unknown keywords are ignored
+        int compile(const Value& schema) {
+            rules.clear();
+            root = -1;
+            int ret = compile_rule(schema, root);
+            if (ret != PARSE_OK) {
+                rules.clear();
+                root = -1;
+            }
+            return ret;
+        }
+
+        // parse the schema text first, its syntax errors are returned as they are
+        int compile(const std::string& text);
+
+        int compile(const char* text) {
+            return compile(std::string(text));
+        }
+    private:
+        friend class value_parse;
+
+        int compile_rule(const Value& schema, int& index) {
+            schema_rule rule;
+            if (schema.isBool()) {
+                rule.never = schema.get_type() == JSON_FALSE;
+                index = rule.never ? add_rule(std::move(rule)) : -1;
+                return PARSE_OK;
+            }
+            if (schema.get_type() != JSON_OBJECT)
+                return PARSE_INVALID_SCHEMA;
+            int ret = PARSE_OK;
+            for (auto mt = schema.begin(); mt != schema.end() && ret == PARSE_OK; ++mt) {
+                const std::string& keyword = mt.name();
+                const Value& value = *mt;
+                if (keyword == "type") {
+                    if (value.get_type() == JSON_STRING)
+                        ret = add_type(rule, value);
+                    else if (value.get_type() == JSON_ARRAY && value.size() > 0) {
+                        for (auto& e : value)
+                            if ((ret = add_type(rule, e)) != PARSE_OK)
+                                break;
+                    }
+                    else
+                        ret = PARSE_INVALID_SCHEMA;
+                }
+                else if (keyword == "properties") {
+                    if (value.get_type() != JSON_OBJECT)
+                        return PARSE_INVALID_SCHEMA;
+                    for (auto pt = value.begin(); pt != value.end(); ++pt) {
+                        int child = -1;
+                        if ((ret = compile_rule(*pt, child)) != PARSE_OK)
+                            break;
+                        rule.properties[pt.name()] = child;
+                    }
+                }
+                else if (keyword == "required") {
+                    if (value.get_type() != JSON_ARRAY)
+                        return PARSE_INVALID_SCHEMA;
+                    for (auto& e : value) {
+                        if (e.get_type() != JSON_STRING)
+                            return PARSE_INVALID_SCHEMA;
+                        rule.required.push_back(e.asString());
+                    }
+                }
+                else if (keyword == "additionalProperties") {
+                    if (value.isBool())
+                        rule.additional = value.get_type() == JSON_TRUE;
+                    else
+                        ret = compile_rule(value, rule.additional_rule);
+                }
+                else if (keyword == "items")
+                    ret = compile_rule(value, rule.items);
+                else if (keyword == "enum") {
+                    if (value.get_type() != JSON_ARRAY)
+                        return PARSE_INVALID_SCHEMA;
+                    rule.has_enum = true;
+                    for (auto& e : value)
+                        rule.enumeration.push_back(e);
+                }
+                else if (keyword == "minimum")
+                    ret = get_bound(value, rule.has_minimum, rule.minimum);
+                else if (keyword == "exclusiveMinimum")
+                    ret = get_bound(value, rule.has_exclusive_minimum, rule.exclusive_minimum);
+                else if (keyword == "maximum")
+                    ret = get_bound(value, rule.has_maximum, rule.maximum);
+                else if (keyword == "exclusiveMaximum")
+                    ret = get_bound(value, rule.has_exclusive_maximum, rule.exclusive_maximum);
+                else if (keyword == "minLength")
+                    ret = get_count(value, rule.min_length);
+                else if (keyword == "maxLength")
+                    ret = get_count(value, rule.max_length);
+                else if (keyword == "minItems")
+                    ret = get_count(value, rule.min_items);
+                else if (keyword == "maxItems")
+                    ret = get_count(value, rule.max_items);
+            }
+            if (ret == PARSE_OK)
+                index = add_rule(std::move(rule));
+            return ret;
+        }
+
+        static int add_type(schema_rule& rule, const Value& name) {
+            if (name.get_type() != JSON_STRING)
+                return PARSE_INVALID_SCHEMA;
+            std::string type = name.asString();
+            if (type == "null")
+                rule.types |= 1u << JSON_NULL;
+            else if (type == "boolean")
+                rule.types |= (1u << JSON_TRUE) | (1u << JSON_FALSE);
+            else if (type == "number")
+                rule.types |= 1u << JSON_NUMBER;
+            else if (type == "integer") {
+                rule.types |= 1u << JSON_NUMBER;
+                rule.integer = true;
+            }
+            else if (type == "string")
+                rule.types |= 1u << JSON_STRING;
+            else if (type == "array")
+                rule.types |= 1u << JSON_ARRAY;
+            else if (type == "object")
+                rule.types |= 1u << JSON_OBJECT;
+            else
+                return PARSE_INVALID_SCHEMA;
+            return PARSE_OK;
+        }
+
+        static int get_count(const Value& value, size_t& count) {
+            if (value.get_type() != JSON_NUMBER || value.asDouble() < 0 || value.asDouble() != floor(value.asDouble()))
+                return PARSE_INVALID_SCHEMA;
+            count = static_cast<size_t>(value.asDouble());
+            return PARSE_OK;
+        }
+
+        static int get_bound(const Value& value, bool& has_bound, double& bound) {
+            if (value.get_type() != JSON_NUMBER)
+                return PARSE_INVALID_SCHEMA;
+            has_bound = true;
+            bound = value.asDouble();
+            return PARSE_OK;
+        }
+
+        int add_rule(schema_rule&& rule) {
+            rules.push_back(std::move(rule));
+            return static_cast<int>(rules.size() - 1);
+        }
+    private:
+        std::vector<schema_rule> rules;
+        int root = -1;
+    };
+
+    // fixed set of worker threads used by the parallel writer and parser
+    class task_pool {
+    public:
+        explicit task_pool(size_t thread_count) :stop(false) {
+            if (thread_count == 0)
+                thread_count = 1;
+            for (size_t i = 0; i < thread_count; i++)
+                workers.emplace_back([this] { run(); });
+        }
+
+        ~task_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stop = true;
+            }
+            cv.notify_all();
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        task_pool(const task_pool&) = delete;
+
+        task_pool& operator=(const task_pool&) = delete;
+
+        size_t size() const {
+            return workers.size();
+        }
+
+        template <typename F>
+        std::future<typename std::result_of<F()>::type> submit(F task) {
+            typedef typename std::result_of<F()>::type result_type;
+            auto packaged = std::make_shared<std::packaged_task<result_type()>>(std::move(task));
+            std::future<result_type> result = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                tasks.push([packaged] { (*packaged)(); });
+            }
+            cv.notify_one();
+            return result;
+        }
+    private:
+        void run() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [this] { return stop || !tasks.empty(); });
+                    if (stop && tasks.empty())
+                        return;
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stop;
+    };
+
+    // looks only at strings, brackets and commas to find the values sitting directly
+    // inside the containers of one depth (the root container is depth 1), so it runs far
+    // ahead of the real parser; text can be fed piece by piece
+    class element_scanner {
+    public:
+        explicit element_scanner(size_t _depth = 1) :depth(_depth) {}
+
+        // on_element(begin, end) gets absolute offsets of every value found at depth
+        template <typename F>
+        void feed(const char* data, size_t length, F on_element) {
+            for (size_t i = 0; i < length && !error; i++, offset++) {
+                char ch = data[i];
+                if (in_string) {
+                    if (escaped)
+                        escaped = false;
+                    else if (ch == '\\')
+                        escaped = true;
+                    else if (ch == '\"') {
+                        in_string = false;
+                        if (stack.size() >= depth)
+                            last_content = offset + 1;
+                    }
+                    continue;
+                }
+                switch (ch) {
+                case ' ': case '\t': case '\n': case '\r':
+                    break;
+                case '\"':
+                    mark_content();
+                    in_string = true;
+                    break;
+                case '[': case '{':
+                    mark_content();
+                    stack.push_back(ch);
+                    after_comma = false;
+                    break;
+                case ']': case '}':
+                    if (stack.empty() || (ch == ']') != (stack.back() == '[')) {
+                        error = true;
+                        break;
+                    }
+                    if (stack.size() == depth)
+                        end_element(on_element);
+                    else if (stack.size() > depth)
+                        last_content = offset + 1;
+                    stack.pop_back();
+                    if (stack.empty())
+                        closed = true;
+                    break;
+                case ',':
+                    if (stack.size() == depth) {
+                        if (!in_element)
+                            error = true;
+                        end_element(on_element);
+                        after_comma = true;
+                    }
+                    else if (stack.size() > depth)
+                        last_content = offset + 1;
+                    break;
+                default:
+                    mark_content();
+                    break;
+                }
+            }
+        }
+
+        // the scanned text was one container with nothing odd behind it
+        bool complete() const {
+            return !error && closed && stack.empty() && !in_string;
+        }
+
+        bool failed() const {
+            return error;
+        }
+    private:
+        void mark_content() {
+            // a second root value or a value after the root closed
+            if (stack.empty() && (closed || in_root_value))
+                error = true;
+            if (stack.empty())
+                in_root_value = true;
+            if (stack.size() == depth && !in_element) {
+                in_element = true;
+                element_begin = offset;
+            }
+            if (stack.size() >= depth)
+                last_content = offset + 1;
+        }
+
+        template <typename F>
+        void end_element(F& on_element) {
+            if (in_element)
+                on_element(element_begin, last_content);
+            // "[ 1, ]" has an empty element behind the comma
+            else if (after_comma)
+                error = true;
+            in_element = false;
+            after_comma = false;
+        }
+    private:
+        size_t depth;
+        size_t offset = 0;
+        size_t element_begin = 0;
+        size_t last_content = 0;
+        std::vector<char> stack;
+        bool in_string = false;
+        bool escaped = false;
+        bool in_element = false;
+        bool after_comma = false;
+        bool in_root_value = false;
+        bool closed = false;
+        bool error = false;
+    };
+
+#define ISDIGIT(num) ((num >= '0') && (num <= '9'))
+#define ISDIGIT1TO9(num) ((num >= '1') && (num <= '9'))
+#define CHECK_ITERATOR(it) do { if (it == json_source.end()) return PARSE_MISS_QUOTATION_MARK; } while(0)
+
+    // lexical part shared by every parser, knows nothing about the result type
+    class json_lexer {
+    public:
+        void set_features(const Features& _features) {
+            features = _features;
+        }
+
+        // where the failing value starts, or the first byte of a bad UTF-8 sequence
+        size_t get_error_offset() const {
+            return error_offset;
+        }
+
+        // offset of the first byte that does not start a well formed UTF-8
+        // sequence (RFC 3629: no overlong forms, no surrogates, nothing above
+        // U+10FFFF), length if there is none
+        static size_t find_invalid_utf8(const char* data, size_t length) {
+            size_t i = 0;
+            while (i < length) {
+                // pure ASCII blocks are the common case, only look at the high bits
+#ifdef __SSE2__
+                while (length - i >= 64) {
+                    const __m128i* block = reinterpret_cast<const __m128i*>(data + i);
+                    __m128i high = _mm_or_si128(
+                        _mm_or_si128(_mm_loadu_si128(block), _mm_loadu_si128(block + 1)),
+                        _mm_or_si128(_mm_loadu_si128(block + 2), _mm_loadu_si128(block + 3)));
+                    if (_mm_movemask_epi8(high) != 0)
+                        break;
+                    i += 64;
+                }
+#else
+                while (length - i >= 8) {
+                    unsigned long long word;
+                    memcpy(&word, data + i, 8);
+                    if (word & 0x8080808080808080ULL)
+                        break;
+                    i += 8;
+                }
+#endif
+                // a block with multi byte sequences goes through the scalar check
+                size_t block_end = std::min(length, i + 64);
+                while (i < block_end) {
+                    if (static_cast<unsigned char>(data[i]) < 0x80) {
+                        i++;
+                        continue;
+                    }
+                    size_t sequence = utf8_sequence(reinterpret_cast<const unsigned char*>(data + i), length - i);
+                    if (sequence == 0)
+                        return i;
+                    i += sequence;
+                }
+            }
+            return length;
+        }
+    protected:
+        static size_t utf8_sequence(const unsigned char* p, size_t remain) {
+            unsigned char lead = p[0];
+            size_t length = 0;
+            unsigned char low = 0x80, high = 0xBF;
+            if (lead >= 0xC2 && lead <= 0xDF)
+                length = 2;
+            else if (lead >= 0xE0 && lead <= 0xEF) {
+                length = 3;
+                if (lead == 0xE0)
+                    low = 0xA0;
+                else if (lead == 0xED)
+                    high = 0x9F;
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4) {
+                length = 4;
+                if (lead == 0xF0)
+                    low = 0x90;
+                else if (lead == 0xF4)
+                    high = 0x8F;
+            }
+            else
+                return 0;
+            if (remain < length || p[1] < low || p[1] > high)
+                return 0;
+            for (size_t i = 2; i < length; i++) {
+                if (p[i] < 0x80 || p[i] > 0xBF)
+                    return 0;
+            }
+            return length;
+        }
+
+        // run before parsing when validateUtf8 is on
+        int check_source() {
+            error_offset = 0;
+            if (!features.validateUtf8)
+                return PARSE_OK;
+            size_t offset = find_invalid_utf8(json_source.data(), json_source.size());
+            if (offset == json_source.size())
+                return PARSE_OK;
+            error_offset = offset;
+            return PARSE_INVALID_UTF8;
+        }
+
+        void set_source(const std::string& source) {
+            json_source = source;
+            it = json_source.begin();
+        }
+
+        void set_source(std::string&& source) {
+            json_source = std::move(source);
+            it = json_source.begin();
+        }
+
+        void set_source(const char* data, size_t length) {
+            json_source.assign(data, length);
+            it = json_source.begin();
+        }
+
+        void skip_blank() {
+            while (it != json_source.end() && (*it == ' ' || *it == '\t' || *it == '\n' || *it == '\r'))
+                it++;
+        }
+
+        // check the number grammar, tmp_it stops behind the number
+        int scan_number(std::string::const_iterator& tmp_it) {
+            if (*tmp_it == '-')
+                tmp_it++;
+            if (*tmp_it == '0')
+                tmp_it++;
+            else {
+                if (!ISDIGIT1TO9(*tmp_it))
+                    return PARSE_INVALID_VALUE;
+                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
+            }
+            if (*tmp_it == '.') {
+                tmp_it++;
+                if (!ISDIGIT(*tmp_it))
+                    return PARSE_INVALID_VALUE;
+                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
+            }
+            if (*tmp_it == 'e' || *tmp_it == 'E') {
+                tmp_it++;
+                if (*tmp_it == '-' || *tmp_it == '+')
+                    tmp_it++;
+                if (!ISDIGIT(*tmp_it))
+                    return PARSE_INVALID_VALUE;
+                for (tmp_it++; ISDIGIT(*tmp_it); tmp_it++);
+            }
+            return PARSE_OK;
+        }
+
+        int parse_string(std::string& tmp_str, std::string::const_iterator& tmp_it) {
+            char ch = 0;
+            tmp_it++;
+            while (tmp_it != json_source.end()) {
+                ch = *tmp_it++;
+                switch (ch) {
+                case '\"':
+                    return PARSE_OK;
+                case '\\':
+                    if (tmp_it != json_source.end()) {
+                        switch (*tmp_it++) {
+                        case '\"': tmp_str += '\"'; break;
+                        case 'n': tmp_str += '\n'; break;
+                        case 'r': tmp_str += '\r'; break;
+                        case 't': tmp_str += '\t'; break;
+                        case 'f': tmp_str += '\f'; break;
+                        case 'b': tmp_str += '\b'; break;
+                        case '/': tmp_str += '/'; break;
+                        case '\\': tmp_str += '\\'; break;
+                        case 'u': { 
+                            unsigned u = 0;
+                            int ret = 0;
+                            if ((ret = parse_hex4(tmp_it, u)) != PARSE_OK)
+                                return ret;
+                            if (u >= 0xD800 && u <= 0xDBFF) {
+                                CHECK_ITERATOR(tmp_it);
+                                if (*tmp_it++ != '\\')
+                                    return PARSE_INVALID_UNICODE_SURROGATE;
+                                CHECK_ITERATOR(tmp_it);
+                                if (*tmp_it++ != 'u')
+                                    return PARSE_INVALID_UNICODE_SURROGATE;
+                                unsigned tmp_u;
+                                if ((ret = parse_hex4(tmp_it, tmp_u)) != PARSE_OK)
+                                    return ret;
+                                if (tmp_u <0xDC00 || tmp_u > 0xDFFF)
+                                    return PARSE_INVALID_UNICODE_SURROGATE;
+                                u = 0x10000 + (u - 0xD800) * 0x400 + (tmp_u - 0xDC00);
+                            }
+                            if (u > 0x10FFFF)
+                                return PARSE_INVALID_UNICODE_HEX;
+                            encode_utf8(u, tmp_str);
+                            break;
+                        }
+                        default: return PARSE_INVALID_STRING_ESCAPE;
+                        }
+                    }
+                    else
+                        return PARSE_MISS_QUOTATION_MARK;
+                    break;
+                case '\0':
+                    return PARSE_MISS_QUOTATION_MARK;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20)
+                        return PARSE_INVALID_STRING_CHAR;
+                    tmp_str += ch;
+                    break;
+                }
+            }
+            return PARSE_MISS_QUOTATION_MARK;
+        }
+
+        // the value is well formed json but has another type than the target
+        int mismatch() {
+            if (it == json_source.end())
+                return PARSE_EXPECT_VALUE;
+            switch (*it) {
+            case 'n': case 't': case 'f': case '[': case '{': case '\"':
+                return PARSE_TYPE_MISMATCH;
+            case '\0':
+                return PARSE_EXPECT_VALUE;
+            default:
+                if (*it == '-' || ISDIGIT(*it))
+                    return PARSE_TYPE_MISMATCH;
+                return PARSE_INVALID_VALUE;
+            }
+        }
+
+        bool is_number() {
+            return it != json_source.end() && (*it == '-' || ISDIGIT(*it));
+        }
+
+        int skip_literal(const char* dst) {
+            int len = strlen(dst);
+            if (strncmp(&(*it), dst, len) != 0)
+                return PARSE_INVALID_VALUE;
+            it += len;
+            return PARSE_OK;
+        }
+
+        // check and step over a whole value without building anything
+        int skip_value() {
+            if (it == json_source.end())
+                return PARSE_EXPECT_VALUE;
+            int ret = 0;
+            std::string::const_iterator tmp_it = it;
+            switch (*it) {
+            case 'n': return skip_literal("null");
+            case 't': return skip_literal("true");
+            case 'f': return skip_literal("false");
+            case '\0': return PARSE_EXPECT_VALUE;
+            case '\"': {
+                std::string tmp_str;
+                if ((ret = parse_string(tmp_str, tmp_it)) == PARSE_OK)
+                    it = tmp_it;
+                return ret;
+            }
+            case '[':
+                it++;
+                skip_blank();
+                if (it != json_source.end() && *it == ']') {
+                    it++;
+                    return PARSE_OK;
+                }
+                for (;;) {
+                    skip_blank();
+                    if ((ret = skip_value()) != PARSE_OK)
+                        return ret;
+                    skip_blank();
+                    if (it == json_source.end())
+                        return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                    if (*it == ']') {
+                        it++;
+                        return PARSE_OK;
+                    }
+                    if (*it++ != ',')
+                        return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                }
+            case '{':
+                it++;
+                skip_blank();
+                if (it != json_source.end() && *it == '}') {
+                    it++;
+                    return PARSE_OK;
+                }
+                for (;;) {
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it != '\"')
+                        return PARSE_MISS_KEY;
+                    std::string key_str;
+                    tmp_it = it;
+                    if (parse_string(key_str, tmp_it) != PARSE_OK)
+                        return PARSE_MISS_KEY;
+                    it = tmp_it;
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it++ != ':')
+                        return PARSE_MISS_COLON;
+                    skip_blank();
+                    if ((ret = skip_value()) != PARSE_OK)
+                        return ret;
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it == '}') {
+                        it++;
+                        return PARSE_OK;
+                    }
+                    if (*it++ != ',')
+                        return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                }
+            default:
+                if (*it == '-' || ISDIGIT(*it)) {
+                    if ((ret = scan_number(tmp_it)) == PARSE_OK)
+                        it = tmp_it;
+                    return ret;
+                }
+                return PARSE_INVALID_VALUE;
+            }
+        }
+
+        int parse_hex4(std::string::const_iterator& tmp_it, unsigned& u) {
+            u = 0;
+            char ch = 0;
+            for (int i = 0; i < 4; i++) {
+                u <<= 4;
+                CHECK_ITERATOR(tmp_it);
+                ch = *tmp_it++;
+                if (ch >= '0' && ch <= '9')
+                    u |= ch - '0';
+                else if (ch >= 'a' && ch <= 'f')
+                    u |= ch - 'a' + 10;
+                else if (ch >= 'A' && ch <= 'F')
+                    u |= ch - 'A' + 10;
+                else return PARSE_INVALID_UNICODE_HEX;
+            }
+            return PARSE_OK;
+        }
+
+        void encode_utf8(unsigned& u, std::string& tmp_str) {
+            if (u <= 0x7F)
+                tmp_str += (u & 0xFF);
+            else if (u <= 0x7FF) {
+                tmp_str += (0xC0 | (0xFF & (u >> 6)));
+                tmp_str += (0x80 | (0x3F & u));
+            }
+            else if (u <= 0xffff) {
+                tmp_str += (0xE0 | (0xFF & (u >> 12)));
+                tmp_str += (0x80 | (0x3F & (u >> 6)));
+                tmp_str += (0x80 | (0x3F & u));
+            }
+            else {
+                tmp_str += (0xF0 | (0xFF & (u >> 18)));
+                tmp_str += (0x80 | (0x3F & (u >> 12)));
+                tmp_str += (0x80 | (0x3F & (u >> 6)));
+                tmp_str += (0x80 | (0x3F & u));
+            }    
+        }
+    protected:
+        std::string json_source;
+        std::string::const_iterator it;
+        Features features;
+        size_t error_offset = 0;
+    };
+
+    // an object layout seen before: its raw keys in text order, the sorted position
+    // of each, and the members with null values to copy from
+    struct object_shape {
+        std::vector<std::string> keys;
+        std::vector<size_t> ranks;
+        Value::object_type prototype;
+    };
+
+    class value_parse : public json_lexer {
+    public:
+        void set_json_source(const std::string& source, Value* value) {
+            set_source(source);
+            root = value;
+        }
+
+        void set_json_source(std::string&& source, Value* value) {
+            set_source(std::move(source));
+            root = value;
+        }
+
+        void set_json_source(const char* data, size_t length, Value* value) {
+            set_source(data, length);
+            root = value;
+        }
+
+        // checked while parsing, nullptr (or an empty Schema) checks nothing
+        void set_schema(const Schema* _schema) {
+            schema = _schema;
+        }
+
+        // JSON Pointer to the value that broke the schema
+        const std::string& get_schema_path() const {
+            return schema_path;
+        }
+
+        int parse()
+        {
+            int ret = 0;
+            schema_path.clear();
+            mismatch_found = false;
+            seen.clear();
+            key_spans.clear();
+            shape_slots.clear();
+            lazy_source.reset();
+            if ((ret = check_source()) != PARSE_OK)
+                return ret;
+            skip_blank();
+            const schema_rule* rule = nullptr;
+            if (schema != nullptr && schema->root >= 0)
+                rule = &schema->rules[schema->root];
+            if ((ret = parse_value(nullptr, rule)) == PARSE_OK) {
+                skip_blank();
+                if (it != json_source.end()) {
+                    root->clear();
+                    ret = PARSE_ROOT_NOT_SINGULAR;
+                }
+            }
+            if (ret != PARSE_OK)
+                error_offset = it - json_source.begin();
+            return ret;
+        }
+    private:
+        int parse_value(Value* element = nullptr, const schema_rule* rule = nullptr) {
+            if (it == json_source.end())
+                return PARSE_EXPECT_VALUE;
+            if (rule == nullptr)
+                return dispatch_value(element, nullptr);
+            // the type is known from the first byte, reject before building anything
+            std::string::const_iterator start = it;
+            json_type type = JSON_NUMBER;
+            switch (*it) {
+            case 'n': type = JSON_NULL; break;
+            case 't': type = JSON_TRUE; break;
+            case 'f': type = JSON_FALSE; break;
+            case '[': type = JSON_ARRAY; break;
+            case '{': type = JSON_OBJECT; break;
+            case '\"': type = JSON_STRING; break;
+            default: break;
+            }
+            if (rule->never || (rule->types != 0 && (rule->types & (1u << type)) == 0)) {
+                mismatch_found = true;
+                return PARSE_SCHEMA_MISMATCH;
+            }
+            int ret = dispatch_value(element, rule);
+            if (ret == PARSE_OK && rule->has_enum) {
+                const Value& value = element != nullptr ? *element : *root;
+                if (std::find(rule->enumeration.begin(), rule->enumeration.end(), value) == rule->enumeration.end())
+                    ret = PARSE_SCHEMA_MISMATCH;
+            }
+            // report the start of the innermost failing value rather than its end
+            if (ret == PARSE_SCHEMA_MISMATCH && !mismatch_found) {
+                mismatch_found = true;
+                it = start;
+            }
+            return ret;
+        }
+
+        int dispatch_value(Value* element, const schema_rule* rule) {
+            switch (*it) {
+            case 'n': return parse_literal("null", JSON_NULL, element);
+            case 't': return parse_literal("true", JSON_TRUE, element);
+            case 'f': return parse_literal("false", JSON_FALSE, element);
+            case '[': return parse_array(element, rule);
+            case '{': return parse_object(element, rule);
+            case '\"': return parse_string(element, rule);
+            case '\0': return PARSE_EXPECT_VALUE;
+            default:
+                if (*it == '-' || (*it >= '0' && *it <= '9')) {
+                    return parse_number(element, rule);
+                }
+                return PARSE_INVALID_VALUE;
+            }
+        }
+
+        // the rule a member or an element is checked against, nullptr for anything
+        const schema_rule* child_rule(int index) const {
+            return index >= 0 ? &schema->rules[index] : nullptr;
+        }
+
+        int parse_literal(const char* dst, json_type type, Value* element = nullptr) {
+            int len = strlen(dst);
+            if (strncmp(&(*it), dst, len) == 0) {
+                it += len;
+                if (element != nullptr) {
+                    switch (type) {
+                    case JSON_NULL: element->clear(); break;
+                    case JSON_TRUE: *element = true; break;
+                    case JSON_FALSE: *element = false; break;
+                    }
+                }
+                else {
+                    switch (type) {
+                    case JSON_NULL: root->clear(); break;
+                    case JSON_TRUE: *root = true; break;
+                    case JSON_FALSE: *root = false; break;
+                    }
+                }
+                return PARSE_OK;
+            }
+            else
+                return PARSE_INVALID_VALUE;
+        }
+
+        int read_number(double& dst_number) {
+            std::string::const_iterator tmp_it = it;
+            int ret = 0;
+            if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                return ret;
+            errno = 0;
+            dst_number = strtod(&(*it), NULL);
+            if (errno == ERANGE && (dst_number == HUGE_VAL || dst_number == -HUGE_VAL))
+                return PARSE_NUMBER_OVERFLOW;
+            it = tmp_it;
+            return PARSE_OK;
+        }
+
+        // only the decimal exponent of a literal far up can take a double past HUGE_VAL
+        static bool may_overflow(std::string::const_iterator begin, std::string::const_iterator end) {
+            long magnitude = 0, exponent = 0;
+            for (; begin != end && *begin != '.' && *begin != 'e' && *begin != 'E'; ++begin)
+                magnitude++;
+            while (begin != end && *begin != 'e' && *begin != 'E')
+                ++begin;
+            if (begin != end) {
+                ++begin;
+                bool negative = begin != end && *begin == '-';
+                if (begin != end && (*begin == '-' || *begin == '+'))
+                    ++begin;
+                for (; begin != end && exponent < 100000; ++begin)
+                    exponent = exponent * 10 + (*begin - '0');
+                if (negative)
+                    exponent = -exponent;
+            }
+            return magnitude + exponent > 300;
+        }
+
+        int parse_number(Value* element = nullptr, const schema_rule* rule = nullptr) {
+            double dst_number = 0;
+            int ret = 0;
+            bool checked = rule != nullptr && (rule->integer || rule->has_minimum || rule->has_maximum
+                || rule->has_exclusive_minimum || rule->has_exclusive_maximum);
+            if (features.lazyNumbers && !checked) {
+                std::string::const_iterator tmp_it = it;
+                if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                    return ret;
+                size_t offset = it - json_source.begin();
+                size_t length = tmp_it - it;
+                // converted now only when it could overflow or the offsets cannot hold it
+                if (!may_overflow(it, tmp_it) && offset + length <= UINT32_MAX) {
+                    if (!lazy_source)
+                        lazy_source = std::make_shared<std::string>(json_source);
+                    it = tmp_it;
+                    target(element).set_raw_number(lazy_source, offset, length);
+                    return PARSE_OK;
+                }
+            }
+            if ((ret = read_number(dst_number)) != PARSE_OK)
+                return ret;
+            if (rule != nullptr) {
+                if ((rule->integer && dst_number != floor(dst_number))
+                    || (rule->has_minimum && dst_number < rule->minimum)
+                    || (rule->has_exclusive_minimum && dst_number <= rule->exclusive_minimum)
+                    || (rule->has_maximum && dst_number > rule->maximum)
+                    || (rule->has_exclusive_maximum && dst_number >= rule->exclusive_maximum))
+                    return PARSE_SCHEMA_MISMATCH;
+            }
+            if (element != nullptr)
+                *element = dst_number;
+            else
+                *root = dst_number;
+            return PARSE_OK;
+        }
+
+        using json_lexer::parse_string;
+
+        int parse_string(Value* element = nullptr, const schema_rule* rule = nullptr) {
+            std::string tmp_str;
+            // in reuse mode the characters go straight into the old string's capacity
+            std::string& dst_str = features.reuseStorage ? target(element).reuse_string() : tmp_str;
+            std::string::const_iterator tmp_it = it;
+            int ret = parse_string(dst_str, tmp_it);
+            if (ret == PARSE_OK && rule != nullptr) {
+                // lengths count code points, not bytes
+                size_t length = 0;
+                for (auto e : dst_str)
+                    length += (static_cast<unsigned char>(e) & 0xC0) != 0x80;
+                if (length < rule->min_length || length > rule->max_length)
+                    return PARSE_SCHEMA_MISMATCH;
+            }
+            if (ret == PARSE_OK) {
+                it = tmp_it;
+                if (&dst_str == &tmp_str)
+                    target(element) = std::move(tmp_str);
+            }
+            return ret;
+        }
+
+        // numbers up to the closing bracket; stops in front of the first element that
+        // is not a number and leaves closed false
+        int parse_numbers(std::vector<double>& numbers, const schema_rule* rule, bool& closed) {
+            int ret = 0;
+            double number = 0;
+            while (*it == '-' || (*it >= '0' && *it <= '9')) {
+                if ((ret = read_number(number)) != PARSE_OK)
+                    return ret;
+                numbers.push_back(number);
+                skip_blank();
+                if (rule != nullptr && numbers.size() > rule->max_items)
+                    return PARSE_SCHEMA_MISMATCH;
+                if (*it == ',') {
+                    it++;
+                    skip_blank();
+                }
+                else if (*it == ']') {
+                    it++;
+                    closed = true;
+                    break;
+                }
+                else
+                    return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+            }
+            return PARSE_OK;
+        }
+
+        int parse_array(Value* element = nullptr, const schema_rule* rule = nullptr) {
+            it++;
+            const schema_rule* items = rule != nullptr ? child_rule(rule->items) : nullptr;
+            int ret = 0;
+            skip_blank();
+            // an array that opens with a number is read as plain doubles; a long one that
+            // holds nothing else is stored packed, the others go on as ordinary elements
+            bool packing = items == nullptr && !features.lazyNumbers && (*it == '-' || (*it >= '0' && *it <= '9'));
+            bool closed = false;
+            if (packing) {
+                number_buffer.clear();
+                if ((ret = parse_numbers(number_buffer, rule, closed)) != PARSE_OK)
+                    return ret;
+                if (closed && number_buffer.size() >= min_packed_numbers) {
+                    if (rule != nullptr && number_buffer.size() < rule->min_items)
+                        return PARSE_SCHEMA_MISMATCH;
+                    if (features.reuseStorage)
+                        target(element).reuse_numbers().assign(number_buffer.begin(), number_buffer.end());
+                    else
+                        target(element).setNumbers(std::move(number_buffer));
+                    return PARSE_OK;
+                }
+            }
+            std::vector<Value> tmp_array;
+            // in reuse mode the old elements are parsed over and the extra ones dropped
+            std::vector<Value>& elements = features.reuseStorage ? target(element).reuse_array() : tmp_array;
+            size_t count = 0;
+            if (packing) {
+                count = number_buffer.size();
+                if (elements.size() < count)
+                    elements.resize(count);
+                for (size_t i = 0; i < count; i++)
+                    elements[i] = number_buffer[i];
+            }
+            if (closed || (!packing && *it == ']')) {
+                if (!packing)
+                    it++;
+            }
+            else {
+                while (it != json_source.end()) {
+                    skip_blank();
+                    if (count == elements.size())
+                        elements.emplace_back();
+                    if ((ret = parse_value(&elements[count], items)) != PARSE_OK) {
+                        // the path is built while unwinding, nothing is spent when the document is valid
+                        if (ret == PARSE_SCHEMA_MISMATCH)
+                            schema_path.insert(0, '/' + std::to_string(count));
+                        return ret;
+                    }
+                    count++;
+                    skip_blank();
+                    if (rule != nullptr && count > rule->max_items)
+                        return PARSE_SCHEMA_MISMATCH;
+                    if (*it == ',') {
+                        CHECK_ITERATOR(it);
+                        it++;
+                    }
+                    else if (*it == ']') {
+                        CHECK_ITERATOR(it);
+                        it++;
+                        break;
+                    }
+                    else
+                        return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                }
+            }
+            elements.erase(elements.begin() + count, elements.end());
+            if (rule != nullptr && count < rule->min_items)
+                return PARSE_SCHEMA_MISMATCH;
+            if (&elements == &tmp_array)
+                target(element) = std::move(tmp_array);
+            return PARSE_OK;
+        }
+
+        int parse_object(Value* element = nullptr, const schema_rule* rule = nullptr) {
+            it++;
+            skip_blank();
+            int ret = 0;
+            Value::object_type tmp_object;
+            // in reuse mode members found again are parsed over, the others dropped at the end
+            bool reuse = features.reuseStorage;
+            Value::object_type& members = reuse ? target(element).reuse_object() : tmp_object;
+            size_t mark = seen.size();
+            size_t span_mark = key_spans.size();
+            bool closed = false, hit = false;
+            if (*it == '}')
+                it++;
+            else {
+                // a known layout is matched key by key, a miss continues below
+                object_shape* shape = reuse ? nullptr : match_shape();
+                if (shape != nullptr && (ret = parse_shaped(*shape, tmp_object, rule, closed, hit)) != PARSE_OK)
+                    return ret;
+                while (!closed) {
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it != '\"')
+                        return PARSE_MISS_KEY;
+                    std::string key_str;
+                    std::string& key = reuse ? key_buffer : key_str;
+                    key.clear();
+                    std::string::const_iterator tmp_it = it;
+                    if ((ret = parse_string(key, tmp_it)) != PARSE_OK)
+                        return PARSE_MISS_KEY;
+                    if (!reuse) {
+                        // escapes make the text longer than the key, such keys are never predicted
+                        size_t raw_length = tmp_it - it - 2;
+                        key_spans.push_back(std::make_pair(it - json_source.begin() + 1,
+                            raw_length == key.size() ? raw_length : std::string::npos));
+                    }
+                    it = tmp_it;
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it != ':')
+                        return PARSE_MISS_COLON;
+                    it++;
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    const schema_rule* member = nullptr;
+                    if ((ret = member_rule(rule, key, member)) != PARSE_OK)
+                        return ret;
+                    Value tmp_root;
+                    Value* member_value = &tmp_root;
+                    // key_buffer is overwritten by nested objects, keep the name of the map node
+                    const std::string* name = &key;
+                    if (reuse) {
+                        auto mt = members.find(key);
+                        if (mt == members.end())
+                            mt = members.emplace(key, Value()).first;
+                        seen.push_back(&mt->second);
+                        member_value = &mt->second;
+                        name = &mt->first;
+                    }
+                    if ((ret = parse_value(member_value, member)) != PARSE_OK) {
+                        if (ret == PARSE_SCHEMA_MISMATCH)
+                            schema_path.insert(0, '/' + escape_pointer(*name));
+                        seen.resize(mark);
+                        return ret;
+                    }
+                    if (!reuse)
+                        tmp_object.insert(make_pair(std::move(key_str), std::move(tmp_root)));
+                    skip_blank();
+                    CHECK_ITERATOR(it);
+                    if (*it == '}') {
+                        it++;
+                        break;
+                    }
+                    else if (*it == ',')
+                        it++;
+                    else {
+                        return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                    }
+                }
+            }
+            if (!reuse && !hit)
+                learn_shape(span_mark);
+            key_spans.resize(span_mark);
+            if (reuse)
+                drop_unseen(members, mark);
+            if (rule != nullptr && (ret = check_required(members, *rule)) != PARSE_OK)
+                return ret;
+            if (!reuse)
+                target(element) = std::move(tmp_object);
+            return PARSE_OK;
+        }
+
+        // the schema of a member, unexpected members break the schema at once
+        int member_rule(const schema_rule* rule, const std::string& key, const schema_rule*& member) {
+            if (rule == nullptr)
+                return PARSE_OK;
+            auto pt = rule->properties.find(key);
+            if (pt != rule->properties.end())
+                member = child_rule(pt->second);
+            else if (rule->additional)
+                member = child_rule(rule->additional_rule);
+            else {
+                schema_path.insert(0, '/' + escape_pointer(key));
+                return PARSE_SCHEMA_MISMATCH;
+            }
+            return PARSE_OK;
+        }
+
+        // the cached layout whose first key is the next one in the text
+        object_shape* match_shape() {
+            for (auto& e : shapes) {
+                if (!e.keys.empty() && match_key(e.keys[0]))
+                    return &e;
+            }
+            return nullptr;
+        }
+
+        bool match_key(const std::string& key) {
+            size_t remain = json_source.end() - it;
+            return remain >= key.size() + 2 && it[0] == '\"' && it[key.size() + 1] == '\"'
+                && memcmp(&*(it + 1), key.data(), key.size()) == 0;
+        }
+
+        // the object starts with a copy of the shape's members, keys are compared
+        // with memcmp and values parsed straight into their node; on the first key
+        // that differs the members not reached yet are dropped and the rest is left to
+        // the caller; hit tells that the whole object had exactly the shape's keys
+        int parse_shaped(const object_shape& shape, Value::object_type& members, const schema_rule* rule,
+                         bool& closed, bool& hit) {
+            members = shape.prototype;
+            size_t base = shape_slots.size();
+            for (auto mt = members.begin(); mt != members.end(); ++mt)
+                shape_slots.push_back(mt);
+            int ret = PARSE_OK;
+            size_t count = shape.keys.size();
+            size_t reached = 0;
+            while (reached < count) {
+                const std::string& key = shape.keys[reached];
+                skip_blank();
+                if (!match_key(key))
+                    break;
+                key_spans.push_back(std::make_pair(it - json_source.begin() + 1, key.size()));
+                it += key.size() + 2;
+                skip_blank();
+                if (it == json_source.end() || *it != ':') {
+                    ret = it == json_source.end() ? PARSE_MISS_QUOTATION_MARK : PARSE_MISS_COLON;
+                    break;
+                }
+                it++;
+                skip_blank();
+                if (it == json_source.end()) {
+                    ret = PARSE_MISS_QUOTATION_MARK;
+                    break;
+                }
+                const schema_rule* member = nullptr;
+                if ((ret = member_rule(rule, key, member)) != PARSE_OK)
+                    break;
+                if ((ret = parse_value(&shape_slots[base + shape.ranks[reached]]->second, member)) != PARSE_OK) {
+                    if (ret == PARSE_SCHEMA_MISMATCH)
+                        schema_path.insert(0, '/' + escape_pointer(key));
+                    break;
+                }
+                reached++;
+                skip_blank();
+                if (it == json_source.end()) {
+                    ret = PARSE_MISS_QUOTATION_MARK;
+                    break;
+                }
+                if (*it == '}') {
+                    it++;
+                    closed = true;
+                    break;
+                }
+                if (*it != ',') {
+                    ret = PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                    break;
+                }
+                it++;
+            }
+            if (ret == PARSE_OK) {
+                for (size_t i = reached; i < count; i++)
+                    members.erase(shape_slots[base + shape.ranks[i]]);
+                // with more members than the shape the rest are parsed one by one
+                hit = closed && reached == count;
+            }
+            shape_slots.resize(base);
+            return ret;
+        }
+
+        // a key sequence is cached the second time it is seen, so objects that never
+        // repeat cost one hash each
+        void learn_shape(size_t span_mark) {
+            size_t count = key_spans.size() - span_mark;
+            if (count == 0 || count > max_shape_keys)
+                return;
+            size_t signature = 14695981039346656037ULL & std::numeric_limits<size_t>::max();
+            for (size_t i = span_mark; i < key_spans.size(); i++) {
+                const std::pair<size_t, size_t>& span = key_spans[i];
+                if (span.second == std::string::npos)
+                    return;
+                for (size_t j = 0; j < span.second; j++)
+                    signature = (signature ^ static_cast<unsigned char>(json_source[span.first + j])) * 1099511628211ULL;
+                signature = (signature ^ span.second) * 1099511628211ULL;
+            }
+            size_t* candidate = std::find(candidates, candidates + shape_capacity, signature);
+            if (candidate == candidates + shape_capacity) {
+                candidates[next_candidate++ % shape_capacity] = signature;
+                return;
+            }
+            *candidate = 0;
+            // a layout with the same first key is replaced, it is the one that missed
+            const std::pair<size_t, size_t>& first = key_spans[span_mark];
+            object_shape* shape = nullptr;
+            for (auto& e : shapes) {
+                if (e.keys.empty() || json_source.compare(first.first, first.second, e.keys[0]) == 0) {
+                    shape = &e;
+                    break;
+                }
+            }
+            if (shape == nullptr) {
+                if (shapes.size() < shape_capacity) {
+                    shapes.emplace_back();
+                    shape = &shapes.back();
+                }
+                else
+                    shape = &shapes[next_shape++ % shape_capacity];
+            }
+            shape->keys.clear();
+            shape->ranks.clear();
+            shape->prototype.clear();
+            for (size_t i = span_mark; i < key_spans.size(); i++) {
+                shape->keys.push_back(json_source.substr(key_spans[i].first, key_spans[i].second));
+                shape->prototype.emplace(shape->keys.back(), Value());
+            }
+            // a repeated key can not be predicted
+            if (shape->prototype.size() != count) {
+                shape->keys.clear();
+                shape->prototype.clear();
+                return;
+            }
+            for (auto& e : shape->keys)
+                shape->ranks.push_back(std::distance(shape->prototype.begin(), shape->prototype.find(e)));
+        }
+
+        // erase the members of the previous document that this one did not have
+        void drop_unseen(Value::object_type& members, size_t mark) {
+            std::sort(seen.begin() + mark, seen.end());
+            size_t distinct = std::unique(seen.begin() + mark, seen.end()) - (seen.begin() + mark);
+            if (distinct < members.size()) {
+                for (auto mt = members.begin(); mt != members.end();) {
+                    if (std::binary_search(seen.begin() + mark, seen.begin() + mark + distinct, &mt->second))
+                        ++mt;
+                    else
+                        mt = members.erase(mt);
+                }
+            }
+            seen.resize(mark);
+        }
+
+        Value& target(Value* element) {
+            return element != nullptr ? *element : *root;
+        }
+
+        // a missing member is reported by the path it should have had
+        int check_required(const Value::object_type& object, const schema_rule& rule) {
+            for (auto& e : rule.required) {
+                if (object.find(e) == object.end()) {
+                    schema_path = '/' + escape_pointer(e);
+                    return PARSE_SCHEMA_MISMATCH;
+                }
+            }
+            return PARSE_OK;
+        }
+    private:
+        Value* root;
+        const Schema* schema = nullptr;
+        std::string schema_path;
+        bool mismatch_found = false;
+        // scratch kept between documents so reuse mode stops allocating
+        std::string key_buffer;
+        std::vector<const Value*> seen;
+        // recent object layouts, kept between the documents of one parser (a Reader
+        // object or an NdjsonReader) so NDJSON records hit them
+        static const size_t shape_capacity = 8;
+        static const size_t max_shape_keys = 64;
+        std::vector<object_shape> shapes;
+        size_t next_shape = 0;
+        size_t candidates[shape_capacity] = {};
+        size_t next_candidate = 0;
+        // (offset, length) of the raw keys of the open objects, npos for escaped keys
+        std::vector<std::pair<size_t, size_t>> key_spans;
+        std::vector<Value::object_type::iterator> shape_slots;
+        friend class parallel_parse;
+
+        // numeric arrays shorter than this stay ordinary elements, so that reading
+        // them by reference never has to build anything
+        static const size_t min_packed_numbers = 16;
+        std::vector<double> number_buffer;
+        // the copy of the document lazy numbers point into, made at the first one
+        std::shared_ptr<std::string> lazy_source;
+    };
+
+    inline int Schema::compile(const std::string& text) {
+        Value schema;
+        value_parse parser;
+        parser.set_json_source(text, &schema);
+        int ret = parser.parse();
+        if (ret != PARSE_OK)
+            return ret;
+        return compile(schema);
+    }
+
+    // Binding<T> lists the members of a user struct, specialise it with JSON_BIND
+    template <typename T>
+    struct Binding;
+
+#define JSON_BIND_EXPAND(x) x
+#define JSON_BIND_CAT(a, b) JSON_BIND_CAT_IMPL(a, b)
+#define JSON_BIND_CAT_IMPL(a, b) a##b
+#define JSON_BIND_COUNT(...) JSON_BIND_EXPAND(JSON_BIND_COUNT_IMPL(__VA_ARGS__, \
+    16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define JSON_BIND_COUNT_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define JSON_BIND_FIELD(field) visitor(#field, sizeof(#field) - 1, object.field) &&
+#define JSON_BIND_FIELDS_1(f) JSON_BIND_FIELD(f)
+#define JSON_BIND_FIELDS_2(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_1(__VA_ARGS__))
+#define JSON_BIND_FIELDS_3(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_2(__VA_ARGS__))
+#define JSON_BIND_FIELDS_4(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_3(__VA_ARGS__))
+#define JSON_BIND_FIELDS_5(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_4(__VA_ARGS__))
+#define JSON_BIND_FIELDS_6(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_5(__VA_ARGS__))
+#define JSON_BIND_FIELDS_7(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_6(__VA_ARGS__))
+#define JSON_BIND_FIELDS_8(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_7(__VA_ARGS__))
+#define JSON_BIND_FIELDS_9(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_8(__VA_ARGS__))
+#define JSON_BIND_FIELDS_10(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_9(__VA_ARGS__))
+#define JSON_BIND_FIELDS_11(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_10(__VA_ARGS__))
+#define JSON_BIND_FIELDS_12(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_11(__VA_ARGS__))
+#define JSON_BIND_FIELDS_13(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_12(__VA_ARGS__))
+#define JSON_BIND_FIELDS_14(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_13(__VA_ARGS__))
+#define JSON_BIND_FIELDS_15(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_14(__VA_ARGS__))
+#define JSON_BIND_FIELDS_16(f, ...) JSON_BIND_FIELD(f) JSON_BIND_EXPAND(JSON_BIND_FIELDS_15(__VA_ARGS__))
+
+// use at global scope: JSON_BIND(Point, x, y)
+// the visitor gets every member with its name, the name length is a compile time constant
+#define JSON_BIND(type, ...) \
+    namespace JSON { \
+        template <> \
+        struct Binding<type> { \
+            template <typename Visitor, typename Object> \
+            static bool visit(Visitor& visitor, Object& object) { \
+                return JSON_BIND_EXPAND(JSON_BIND_CAT(JSON_BIND_FIELDS_, JSON_BIND_COUNT(__VA_ARGS__))(__VA_ARGS__)) true; \
+            } \
+        }; \
+    }
+
+    // parse straight into C++ types, no Value tree is built
+    class bind_parse : public json_lexer {
+    public:
+        template <typename T>
+        int parse(const std::string& source, T& object) {
+            set_source(source);
+            int ret = 0;
+            if ((ret = check_source()) != PARSE_OK)
+                return ret;
+            skip_blank();
+            if ((ret = parse_value(object)) == PARSE_OK) {
+                skip_blank();
+                if (it != json_source.end())
+                    ret = PARSE_ROOT_NOT_SINGULAR;
+            }
+            if (ret != PARSE_OK)
+                error_offset = it - json_source.begin();
+            return ret;
+        }
+    private:
+        int parse_value(bool& object) {
+            if (it != json_source.end() && *it == 't') {
+                object = true;
+                return skip_literal("true");
+            }
+            if (it != json_source.end() && *it == 'f') {
+                object = false;
+                return skip_literal("false");
+            }
+            return mismatch();
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_floating_point<T>::value, int>::type parse_value(T& object) {
+            if (!is_number())
+                return mismatch();
+            std::string::const_iterator tmp_it = it;
+            int ret = 0;
+            if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                return ret;
+            errno = 0;
+            double dst_number = strtod(&(*it), NULL);
+            if (errno == ERANGE && (dst_number == HUGE_VAL || dst_number == -HUGE_VAL))
+                return PARSE_NUMBER_OVERFLOW;
+            it = tmp_it;
+            object = static_cast<T>(dst_number);
+            return PARSE_OK;
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type
+        parse_value(T& object) {
+            if (!is_number())
+                return mismatch();
+            std::string::const_iterator tmp_it = it;
+            int ret = 0;
+            if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                return ret;
+            for (std::string::const_iterator ct = it; ct != tmp_it; ct++) {
+                if (*ct == '.' || *ct == 'e' || *ct == 'E')
+                    return PARSE_TYPE_MISMATCH;
+            }
+            errno = 0;
+            if (std::is_signed<T>::value) {
+                long long dst_number = strtoll(&(*it), NULL, 10);
+                if (errno == ERANGE || dst_number < (long long)std::numeric_limits<T>::min()
+                    || dst_number > (long long)std::numeric_limits<T>::max())
+                    return PARSE_NUMBER_OVERFLOW;
+                object = static_cast<T>(dst_number);
+            }
+            else {
+                if (*it == '-')
+                    return PARSE_NUMBER_OVERFLOW;
+                unsigned long long dst_number = strtoull(&(*it), NULL, 10);
+                if (errno == ERANGE || dst_number > (unsigned long long)std::numeric_limits<T>::max())
+                    return PARSE_NUMBER_OVERFLOW;
+                object = static_cast<T>(dst_number);
+            }
+            it = tmp_it;
+            return PARSE_OK;
+        }
+
+        int parse_value(std::string& object) {
+            if (it == json_source.end() || *it != '\"')
+                return mismatch();
+            object.clear();
+            std::string::const_iterator tmp_it = it;
+            int ret = parse_string(object, tmp_it);
+            if (ret == PARSE_OK)
+                it = tmp_it;
+            return ret;
+        }
+
+        int parse_value(Value& object) {
+            std::string::const_iterator begin = it;
+            int ret = 0;
+            if ((ret = skip_value()) != PARSE_OK)
+                return ret;
+            value_parse parser;
+            parser.set_json_source(std::string(begin, it), &object);
+            return parser.parse();
+        }
+
+        template <typename T, typename Alloc>
+        int parse_value(std::vector<T, Alloc>& object) {
+            if (it == json_source.end() || *it != '[')
+                return mismatch();
+            it++;
+            object.clear();
+            skip_blank();
+            if (it != json_source.end() && *it == ']') {
+                it++;
+                return PARSE_OK;
+            }
+            int ret = 0;
+            for (;;) {
+                T element = T();
+                skip_blank();
+                if ((ret = parse_value(element)) != PARSE_OK)
+                    return ret;
+                object.push_back(std::move(element));
+                skip_blank();
+                if (it == json_source.end())
+                    return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                if (*it == ']') {
+                    it++;
+                    return PARSE_OK;
+                }
+                if (*it++ != ',')
+                    return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+            }
+        }
+
+        template <typename T, typename Compare, typename Alloc>
+        int parse_value(std::map<std::string, T, Compare, Alloc>& object) {
+            if (it == json_source.end() || *it != '{')
+                return mismatch();
+            it++;
+            object.clear();
+            skip_blank();
+            if (it != json_source.end() && *it == '}') {
+                it++;
+                return PARSE_OK;
+            }
+            int ret = 0;
+            for (;;) {
+                std::string key_str;
+                if ((ret = parse_key(key_str)) != PARSE_OK)
+                    return ret;
+                T element = T();
+                if ((ret = parse_value(element)) != PARSE_OK)
+                    return ret;
+                object.insert(make_pair(key_str, std::move(element)));
+                skip_blank();
+                CHECK_ITERATOR(it);
+                if (*it == '}') {
+                    it++;
+                    return PARSE_OK;
+                }
+                if (*it++ != ',')
+                    return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            }
+        }
+
+#if __cplusplus >= 201703L
+        template <typename T>
+        int parse_value(std::optional<T>& object) {
+            if (it != json_source.end() && *it == 'n') {
+                object.reset();
+                return skip_literal("null");
+            }
+            T element = T();
+            int ret = parse_value(element);
+            if (ret == PARSE_OK)
+                object = std::move(element);
+            return ret;
+        }
+#endif
+
+        // set the member whose name equals the key, stop visiting once found
+        struct member_parser {
+            member_parser(bind_parse* _parser, const std::string& _key)
+                :parser(_parser), key(_key), ret(PARSE_OK), found(false) {}
+
+            template <typename T>
+            bool operator()(const char* name, size_t length, T& member) {
+                if (length != key.size() || memcmp(name, key.data(), length) != 0)
+                    return true;
+                ret = parser->parse_value(member);
+                found = true;
+                return false;
+            }
+
+            bind_parse* parser;
+            const std::string& key;
+            int ret;
+            bool found;
+        };
+
+        template <typename T>
+        typename std::enable_if<std::is_class<T>::value, int>::type parse_value(T& object) {
+            if (it == json_source.end() || *it != '{')
+                return mismatch();
+            it++;
+            skip_blank();
+            if (it != json_source.end() && *it == '}') {
+                it++;
+                return PARSE_OK;
+            }
+            int ret = 0;
+            std::string key_str;
+            for (;;) {
+                key_str.clear();
+                if ((ret = parse_key(key_str)) != PARSE_OK)
+                    return ret;
+                member_parser visitor(this, key_str);
+                Binding<T>::visit(visitor, object);
+                // keys the struct does not know are checked and dropped
+                ret = visitor.found ? visitor.ret : skip_value();
+                if (ret != PARSE_OK)
+                    return ret;
+                skip_blank();
+                CHECK_ITERATOR(it);
+                if (*it == '}') {
+                    it++;
+                    return PARSE_OK;
+                }
+                if (*it++ != ',')
+                    return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            }
+        }
+
+        // read `"key" :` and stop at the member value
+        int parse_key(std::string& key_str) {
+            skip_blank();
+            CHECK_ITERATOR(it);
+            if (*it != '\"')
+                return PARSE_MISS_KEY;
+            std::string::const_iterator tmp_it = it;
+            if (parse_string(key_str, tmp_it) != PARSE_OK)
+                return PARSE_MISS_KEY;
+            it = tmp_it;
+            skip_blank();
+            CHECK_ITERATOR(it);
+            if (*it != ':')
+                return PARSE_MISS_COLON;
+            it++;
+            skip_blank();
+            return PARSE_OK;
+        }
+    };
+
+    // parse the elements of a big root array/object in partitions on a task_pool,
+    // anything the scanner does not like is left to the sequential parser so the
+    // result and the error number are always the same as Reader::parse
+    class parallel_parse {
+    public:
+        parallel_parse(size_t _thread_count, size_t _min_partition, const Features& _features)
+            :thread_count(_thread_count == 0 ? 1 : _thread_count), min_partition(_min_partition), features(_features) {}
+
+        size_t get_error_offset() const {
+            return error_offset;
+        }
+
+        int parse(const std::string& document, Value& root) {
+            error_offset = 0;
+            // validate once here, the partitions and the fallback skip it
+            Features part_features = features;
+            part_features.validateUtf8 = false;
+            if (features.validateUtf8) {
+                size_t offset = json_lexer::find_invalid_utf8(document.data(), document.size());
+                if (offset != document.size()) {
+                    error_offset = offset;
+                    return PARSE_INVALID_UTF8;
+                }
+            }
+            size_t begin = document.find_first_not_of(" \t\n\r");
+            if (begin == std::string::npos || (document[begin] != '[' && document[begin] != '{'))
+                return sequential(document, root, part_features);
+            // cut the elements into byte balanced partitions while scanning
+            size_t target = std::max(min_partition, document.size() / (thread_count * 4) + 1);
+            std::vector<std::pair<size_t, size_t>> partitions;
+            element_scanner scanner(1);
+            scanner.feed(document.data(), document.size(), [&](size_t element_begin, size_t element_end) {
+                if (partitions.empty() || partitions.back().second - partitions.back().first >= target)
+                    partitions.push_back(std::make_pair(element_begin, element_end));
                 else
-                    *root = tmp_str;
+                    partitions.back().second = element_end;
+            });
+            if (!scanner.complete() || partitions.size() < 2)
+                return sequential(document, root, part_features);
+
+            bool is_array = document[begin] == '[';
+            std::vector<Value> parts(partitions.size());
+            std::vector<size_t> offsets(partitions.size());
+            std::vector<std::future<int>> results;
+            {
+                task_pool pool(thread_count);
+                for (size_t i = 0; i < partitions.size(); i++) {
+                    const std::pair<size_t, size_t>& partition = partitions[i];
+                    Value* part = &parts[i];
+                    size_t* offset = &offsets[i];
+                    results.push_back(pool.submit([&document, &part_features, partition, part, offset, is_array] {
+                        std::string text(is_array ? "[" : "{");
+                        text.append(document, partition.first, partition.second - partition.first);
+                        text += is_array ? ']' : '}';
+                        // lazy numbers point into this partition's copy of the text
+                        value_parse parser;
+                        parser.set_features(part_features);
+                        parser.set_json_source(std::move(text), part);
+                        int ret = parser.parse();
+                        *offset = parser.get_error_offset();
+                        return ret;
+                    }));
+                }
+                // the first failing partition in text order is what the sequential parser would hit
+                for (size_t i = 0; i < results.size(); i++) {
+                    int ret = results[i].get();
+                    if (ret != PARSE_OK) {
+                        // the partition text starts with the added bracket
+                        error_offset = partitions[i].first + offsets[i] - 1;
+                        return ret;
+                    }
+                }
+            }
+            if (is_array) {
+                // numbers only end up packed as the sequential parser would store them
+                size_t total = 0;
+                bool numbers = !features.lazyNumbers;
+                for (const Value& part : parts) {
+                    total += part.size();
+                    if (numbers && !part.isPacked()) {
+                        for (auto& e : part) {
+                            if (e.get_type() != JSON_NUMBER) {
+                                numbers = false;
+                                break;
+                            }
+                        }
+                    }
+                }
+                if (numbers && total >= value_parse::min_packed_numbers) {
+                    std::vector<double> joined;
+                    joined.reserve(total);
+                    for (const Value& part : parts) {
+                        if (part.isPacked())
+                            joined.insert(joined.end(), part.packedNumbers().begin(), part.packedNumbers().end());
+                        else {
+                            for (auto& e : part)
+                                joined.push_back(e.asDouble());
+                        }
+                    }
+                    root.setNumbers(std::move(joined));
+                }
+                else {
+                    Value::array_type elements;
+                    elements.reserve(total);
+                    for (const Value& part : parts) {
+                        for (auto& e : part)
+                            elements.push_back(e);
+                    }
+                    root = std::move(elements);
+                }
+            }
+            else {
+                // insert keeps the first of duplicated keys, like parse_object
+                Value::object_type members;
+                for (const Value& part : parts) {
+                    for (auto mt = part.begin(); mt != part.end(); ++mt)
+                        members.insert(make_pair(mt.name(), *mt));
+                }
+                root = std::move(members);
+            }
+            return PARSE_OK;
+        }
+    private:
+        int sequential(const std::string& document, Value& root, const Features& part_features) {
+            value_parse parser;
+            parser.set_features(part_features);
+            parser.set_json_source(document, &root);
+            int ret = parser.parse();
+            error_offset = parser.get_error_offset();
+            return ret;
+        }
+    private:
+        size_t thread_count;
+        size_t min_partition;
+        Features features;
+        size_t error_offset = 0;
+    };
+
+    // where a streamed document comes from, read() hands out the next piece of text
+    class InputSource {
+    public:
+        virtual ~InputSource() {}
+
+        // replace chunk with the next piece, false at the end of the input
+        virtual bool read(std::string& chunk) = 0;
+
+        // the input ended because of an error rather than its end
+        virtual bool failed() const {
+            return false;
+        }
+    };
+
+    class StringSource : public InputSource {
+    public:
+        explicit StringSource(const std::string& _text, size_t _chunk_size = 1 << 16)
+            :text(_text), chunk_size(_chunk_size == 0 ? 1 : _chunk_size) {}
+
+        bool read(std::string& chunk) {
+            if (offset >= text.size())
+                return false;
+            chunk.assign(text, offset, chunk_size);
+            offset += chunk.size();
+            return true;
+        }
+    private:
+        std::string text;
+        size_t chunk_size;
+        size_t offset = 0;
+    };
+
+    class FileSource : public InputSource {
+    public:
+        explicit FileSource(const std::string& path, size_t _chunk_size = 1 << 20)
+            :file(fopen(path.c_str(), "rb")), chunk_size(_chunk_size == 0 ? 1 : _chunk_size) {}
+
+        ~FileSource() {
+            if (file != nullptr)
+                fclose(file);
+        }
+
+        FileSource(const FileSource&) = delete;
+
+        FileSource& operator=(const FileSource&) = delete;
+
+        bool read(std::string& chunk) {
+            if (file == nullptr)
+                return false;
+            chunk.resize(chunk_size);
+            size_t length = fread(&chunk[0], 1, chunk_size, file);
+            chunk.resize(length);
+            return length > 0;
+        }
+
+        bool failed() const {
+            return file == nullptr || ferror(file) != 0;
+        }
+    private:
+        FILE* file;
+        size_t chunk_size;
+    };
+
+    // bounded hand over of buffers between one producer and one consumer thread,
+    // the buffers travel back and forth so the memory in flight stays fixed
+    class chunk_pipe {
+    public:
+        chunk_pipe(size_t count, size_t capacity) {
+            for (size_t i = 0; i < std::max<size_t>(count, 1); i++) {
+                std::string buffer;
+                buffer.reserve(capacity);
+                empty.push(std::move(buffer));
+            }
+        }
+
+        // producer side, false once the consumer gave up
+        bool get_empty(std::string& buffer) {
+            std::unique_lock<std::mutex> lock(mtx);
+            producer_cv.wait(lock, [this] { return cancelled || !empty.empty(); });
+            if (cancelled)
+                return false;
+            buffer = std::move(empty.front());
+            empty.pop();
+            return true;
+        }
+
+        void put_full(std::string&& buffer) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                full.push(std::move(buffer));
+            }
+            consumer_cv.notify_one();
+        }
+
+        void finish() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                finished = true;
+            }
+            consumer_cv.notify_one();
+        }
+
+        // consumer side, the old content of buffer goes back to the producer
+        bool get_full(std::string& buffer) {
+            std::unique_lock<std::mutex> lock(mtx);
+            consumer_cv.wait(lock, [this] { return finished || !full.empty(); });
+            if (full.empty())
+                return false;
+            buffer.clear();
+            empty.push(std::move(buffer));
+            buffer = std::move(full.front());
+            full.pop();
+            lock.unlock();
+            producer_cv.notify_one();
+            return true;
+        }
+
+        void cancel() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                cancelled = true;
+            }
+            producer_cv.notify_one();
+        }
+    private:
+        std::queue<std::string> empty;
+        std::queue<std::string> full;
+        std::mutex mtx;
+        std::condition_variable producer_cv;
+        std::condition_variable consumer_cv;
+        bool finished = false;
+        bool cancelled = false;
+    };
+
+#ifdef JSON_USE_ZLIB
+    // decompresses on its own thread into chunk_count buffers of chunk_size bytes
+    // while the caller parses the previous ones; plain files are read as they are
+    class GzipSource : public InputSource {
+    public:
+        explicit GzipSource(const std::string& path, size_t _chunk_size = 1 << 20, size_t chunk_count = 4)
+            :file(gzopen(path.c_str(), "rb")), chunk_size(_chunk_size == 0 ? 1 : _chunk_size),
+             pipe(chunk_count, chunk_size) {
+            if (file != nullptr) {
+                gzbuffer(file, 1 << 16);
+                worker = std::thread([this] { run(); });
+            }
+            else
+                pipe.finish();
+        }
+
+        ~GzipSource() {
+            pipe.cancel();
+            if (worker.joinable())
+                worker.join();
+            if (file != nullptr)
+                gzclose(file);
+        }
+
+        GzipSource(const GzipSource&) = delete;
+
+        GzipSource& operator=(const GzipSource&) = delete;
+
+        bool read(std::string& chunk) {
+            return pipe.get_full(chunk);
+        }
+
+        bool failed() const {
+            return file == nullptr || error;
+        }
+    private:
+        void run() {
+            std::string buffer;
+            while (pipe.get_empty(buffer)) {
+                buffer.resize(chunk_size);
+                int length = gzread(file, &buffer[0], static_cast<unsigned>(chunk_size));
+                if (length <= 0) {
+                    error = length < 0;
+                    break;
+                }
+                buffer.resize(length);
+                pipe.put_full(std::move(buffer));
+            }
+            pipe.finish();
+        }
+    private:
+        gzFile file;
+        size_t chunk_size;
+        chunk_pipe pipe;
+        std::thread worker;
+        std::atomic<bool> error{ false };
+    };
+#endif
+
+#ifdef JSON_HAS_POSIX
+    // sidecar index of the byte spans of the values at one depth of a big JSON file
+    // (depth 1 is the elements of the root array), so Reader can parse element n
+    // from the mapped file without touching the rest of it; the index file is a
+    // header followed by one (u64 offset, u32 length) record per element
+    class OffsetIndex {
+    private:
+        static const size_t header_size = 32;
+        static const size_t record_size = 12;
+    public:
+        OffsetIndex() {}
+
+        ~OffsetIndex() {
+            close();
+        }
+
+        OffsetIndex(const OffsetIndex&) = delete;
+
+        OffsetIndex& operator=(const OffsetIndex&) = delete;
+
+        // scan json_path once with constant memory and write the index to index_path;
+        // it is written to a temporary file renamed over index_path only once the
+        // whole scan succeeded, so a failed build leaves index_path as it was
+        static int build(const std::string& json_path, const std::string& index_path, size_t depth = 1) {
+            FILE* input = fopen(json_path.c_str(), "rb");
+            if (input == nullptr)
+                return PARSE_INPUT_ERROR;
+            std::string temp_path;
+            FILE* output = create_temp(index_path, temp_path);
+            if (output == nullptr) {
+                fclose(input);
+                return PARSE_INPUT_ERROR;
+            }
+            element_scanner scanner(depth == 0 ? 1 : depth);
+            unsigned long long count = 0;
+            bool too_long = false;
+            std::string records;
+            std::vector<char> buffer(1 << 20);
+            // room for the header, filled in once the count is known
+            bool io_error = fwrite(std::string(header_size, '\0').data(), 1, header_size, output) != header_size;
+            size_t length = 0, total = 0;
+            while (!io_error && (length = fread(buffer.data(), 1, buffer.size(), input)) > 0) {
+                scanner.feed(buffer.data(), length, [&](size_t begin, size_t end) {
+                    if (end - begin > std::numeric_limits<uint32_t>::max())
+                        too_long = true;
+                    put_record(records, begin, end - begin);
+                    count++;
+                });
+                total += length;
+                if (records.size() >= (1 << 16)) {
+                    io_error = fwrite(records.data(), 1, records.size(), output) != records.size();
+                    records.clear();
+                }
+            }
+            io_error = io_error || ferror(input) != 0;
+            if (!io_error && !records.empty())
+                io_error = fwrite(records.data(), 1, records.size(), output) != records.size();
+            std::string header(magic, 8);
+            put_number(header, depth == 0 ? 1 : depth, 8);
+            put_number(header, count, 8);
+            put_number(header, total, 8);
+            if (!io_error)
+                io_error = fseek(output, 0, SEEK_SET) != 0 || fwrite(header.data(), 1, header_size, output) != header_size;
+            fclose(input);
+            io_error = fclose(output) != 0 || io_error;
+            int ret = io_error ? PARSE_INPUT_ERROR : scanner.complete() && !too_long ? PARSE_OK : PARSE_INVALID_VALUE;
+            if (ret == PARSE_OK && rename(temp_path.c_str(), index_path.c_str()) != 0)
+                ret = PARSE_INPUT_ERROR;
+            if (ret != PARSE_OK)
+                unlink(temp_path.c_str());
+            return ret;
+        }
+
+        // map both files, PARSE_INPUT_ERROR when the index is not the one of json_path
+        int open(const std::string& json_path, const std::string& index_path) {
+            close();
+            size_t index_size = 0;
+            if (!map_file(index_path, index_data, index_size) || index_size < header_size
+                || memcmp(index_data, magic, 8) != 0) {
+                close();
+                return PARSE_INPUT_ERROR;
+            }
+            unsigned long long depth = get_number(index_data + 8, 8);
+            count = get_number(index_data + 16, 8);
+            size_t json_size = get_number(index_data + 24, 8);
+            index_length = index_size;
+            // a count that does not match the size also catches a header whose
+            // multiplication would wrap
+            if (depth == 0 || count > (index_size - header_size) / record_size
+                || index_size != header_size + count * record_size
+                || !map_file(json_path, json_data, json_length) || json_length != json_size) {
+                close();
+                return PARSE_INPUT_ERROR;
+            }
+            return PARSE_OK;
+        }
+
+        void close() {
+            if (json_data != nullptr && json_length > 0)
+                munmap(const_cast<char*>(json_data), json_length);
+            if (index_data != nullptr)
+                munmap(const_cast<char*>(index_data), index_length);
+            json_data = index_data = nullptr;
+            json_length = index_length = 0;
+            count = 0;
+        }
+
+        // number of indexed values
+        size_t size() const {
+            return count;
+        }
+
+        // where value n sits in the mapped file
+        bool element(size_t n, const char*& data, size_t& offset, size_t& length) const {
+            if (n >= count)
+                return false;
+            const char* record = index_data + header_size + n * record_size;
+            offset = get_number(record, 8);
+            length = get_number(record + 8, 4);
+            if (offset + length > json_length)
+                return false;
+            data = json_data + offset;
+            return true;
+        }
+    private:
+        static void put_record(std::string& records, size_t offset, size_t length) {
+            put_number(records, offset, 8);
+            put_number(records, length, 4);
+        }
+
+        // little endian whatever the host is
+        static void put_number(std::string& out, unsigned long long number, size_t bytes) {
+            for (size_t i = 0; i < bytes; i++)
+                out += static_cast<char>((number >> (8 * i)) & 0xFF);
+        }
+
+        static unsigned long long get_number(const char* data, size_t bytes) {
+            unsigned long long number = 0;
+            for (size_t i = 0; i < bytes; i++)
+                number |= static_cast<unsigned long long>(static_cast<unsigned char>(data[i])) << (8 * i);
+            return number;
+        }
+
+        // a new file next to path, its name comes back in temp_path
+        static FILE* create_temp(const std::string& path, std::string& temp_path) {
+            static std::atomic<unsigned> serial{ 0 };
+            for (int attempt = 0; attempt < 100; attempt++) {
+                temp_path = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(serial++);
+                int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+                if (fd >= 0) {
+                    FILE* file = fdopen(fd, "wb");
+                    if (file == nullptr) {
+                        ::close(fd);
+                        unlink(temp_path.c_str());
+                    }
+                    return file;
+                }
+                if (errno != EEXIST)
+                    break;
+            }
+            return nullptr;
+        }
+
+        static bool map_file(const std::string& path, const char*& data, size_t& length) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat info;
+            bool ok = fstat(fd, &info) == 0;
+            length = ok ? static_cast<size_t>(info.st_size) : 0;
+            data = nullptr;
+            if (ok && length > 0) {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+                ok = mapped != MAP_FAILED;
+                data = ok ? static_cast<const char*>(mapped) : nullptr;
+            }
+            ::close(fd);
+            return ok;
+        }
+    private:
+        static constexpr const char* magic = "JSONIDX1";
+        const char* json_data = nullptr;
+        const char* index_data = nullptr;
+        size_t json_length = 0;
+        size_t index_length = 0;
+        size_t count = 0;
+    };
+#endif
+
+    // the static parse() and parseParallel() use the default Features and report only
+    // the error number; a Reader object reads with its own Features through read(),
+    // and getErrorOffset()/getErrorPath() describe its last read
+    class Reader {
+    public:
+        Reader() {}
+
+        explicit Reader(const Features& _features) :features(_features) {}
+
+        static int parse(const std::string& document, Value& root) {
+            return Reader().read(document, root);
+        }
+
+        // split a big root array/object over thread_count threads, partitions
+        // are at least min_partition bytes; same result as parse()
+        static int parseParallel(const std::string& document, Value& root,
+                                 size_t thread_count, size_t min_partition = 1 << 20) {
+            return Reader().readParallel(document, root, thread_count, min_partition);
+        }
+
+        // parse into a type described by JSON_BIND (or a container of them)
+        template <typename T>
+        static int parse(const std::string& document, T& object) {
+            return Reader().read(document, object);
+        }
+
+        int read(const std::string& document, Value& root) {
+            return read(document, root, nullptr);
+        }
+
+        // stop at the first value that breaks schema with PARSE_SCHEMA_MISMATCH,
+        // getErrorPath() tells which one
+        int read(const std::string& document, Value& root, const Schema& schema) {
+            return read(document, root, &schema);
+        }
+
+#ifdef JSON_HAS_POSIX
+        // parse value n of an OffsetIndex, only its own bytes are read
+        int read(const OffsetIndex& index, size_t n, Value& element) {
+            const char* data = nullptr;
+            size_t offset = 0, length = 0;
+            if (!index.element(n, data, offset, length)) {
+                error_offset = 0;
+                return PARSE_INPUT_ERROR;
+            }
+            value_parse parser;
+            parser.set_features(features);
+            parser.set_json_source(data, length, &element);
+            int ret = parser.parse();
+            error_offset = offset + parser.get_error_offset();
+            return ret;
+        }
+
+        // values first .. first + count - 1 as an array
+        int read(const OffsetIndex& index, size_t first, size_t count, Value& elements) {
+            Value::array_type tmp_array(std::min(count, index.size() > first ? index.size() - first : 0));
+            if (tmp_array.size() != count) {
+                error_offset = 0;
+                return PARSE_INPUT_ERROR;
+            }
+            for (size_t i = 0; i < count; i++) {
+                int ret = read(index, first + i, tmp_array[i]);
+                if (ret != PARSE_OK)
+                    return ret;
+            }
+            elements = std::move(tmp_array);
+            return PARSE_OK;
+        }
+#endif
+
+        int readParallel(const std::string& document, Value& root,
+                         size_t thread_count, size_t min_partition = 1 << 20) {
+            parallel_parse parser(thread_count, min_partition, features);
+            int ret = parser.parse(document, root);
+            error_offset = parser.get_error_offset();
+            return ret;
+        }
+
+        template <typename T>
+        int read(const std::string& document, T& object) {
+            bind_parse parser;
+            parser.set_features(features);
+            int ret = parser.parse(document, object);
+            error_offset = parser.get_error_offset();
+            return ret;
+        }
+
+        // byte offset of the last error in the document
+        size_t getErrorOffset() const {
+            return error_offset;
+        }
+
+        // JSON Pointer of the value that broke the schema, "" for the root
+        const std::string& getErrorPath() const {
+            return error_path;
+        }
+    private:
+        int read(const std::string& document, Value& root, const Schema* schema) {
+            parser.set_json_source(document, &root);
+            parser.set_features(features);
+            parser.set_schema(schema);
+            int ret = parser.parse();
+            error_offset = parser.get_error_offset();
+            error_path = parser.get_schema_path();
+            parser.set_schema(nullptr);
+            return ret;
+        }
+    private:
+        Features features;
+        // owned by this Reader, so its reuse scratch (keys, shapes) is never
+        // shared with a Reader on another thread
+        value_parse parser;
+        size_t error_offset = 0;
+        std::string error_path;
+    };
+
+    // splits an InputSource into lines, a line may span several chunks
+    class line_reader {
+    public:
+        explicit line_reader(InputSource& _source) :source(_source) {}
+
+        // the next line without its '\n', false at the end of the input
+        bool next(std::string& line) {
+            line.clear();
+            line_begin = chunk_begin + offset;
+            for (;;) {
+                if (offset >= chunk.size()) {
+                    chunk_begin += chunk.size();
+                    offset = 0;
+                    if (!source.read(chunk)) {
+                        chunk.clear();
+                        return !line.empty();
+                    }
+                }
+                size_t end = chunk.find('\n', offset);
+                if (end == std::string::npos) {
+                    line.append(chunk, offset, std::string::npos);
+                    offset = chunk.size();
+                    continue;
+                }
+                line.append(chunk, offset, end - offset);
+                offset = end + 1;
+                return true;
+            }
+        }
+
+        // offset of the last line in the whole input
+        size_t begin() const {
+            return line_begin;
+        }
+
+        bool failed() const {
+            return source.failed();
+        }
+
+        static bool blank(const std::string& line) {
+            return line.find_first_not_of(" \t\r") == std::string::npos;
+        }
+    private:
+        InputSource& source;
+        std::string chunk;
+        size_t chunk_begin = 0;
+        size_t offset = 0;
+        size_t line_begin = 0;
+    };
+
+    // one JSON text per line (NDJSON), records are parsed as the input arrives so
+    // only the current line is held in memory
+    class NdjsonReader {
+    public:
+        explicit NdjsonReader(InputSource& source, const Features& features = Features()) :lines(source) {
+            parser.set_features(features);
+        }
+
+        // parse the next non blank line into record, false at the end or on an error
+        bool next(Value& record) {
+            if (error != PARSE_OK)
+                return false;
+            while (lines.next(line)) {
+                line_number++;
+                if (line_reader::blank(line))
+                    continue;
+                parser.set_json_source(line, &record);
+                if ((error = parser.parse()) != PARSE_OK)
+                    return false;
+                return true;
+            }
+            if (lines.failed())
+                error = PARSE_INPUT_ERROR;
+            return false;
+        }
+
+        // PARSE_OK after a clean end
+        int getError() const {
+            return error;
+        }
+
+        // line of the last record or error, counting from 1
+        size_t getLine() const {
+            return line_number;
+        }
+    private:
+        line_reader lines;
+        value_parse parser;
+        std::string line;
+        size_t line_number = 0;
+        int error = PARSE_OK;
+    };
+
+    // yields the elements of one huge root array one by one while reading the input in
+    // chunks; only the text of the elements not handed out yet is kept, so memory follows
+    // the largest element, and the element Value is parsed over (reuseStorage) each time
+    class ArrayReader {
+    public:
+        explicit ArrayReader(InputSource& _source, const Features& features = Features()) :source(_source) {
+            Features reuse = features;
+            reuse.reuseStorage = true;
+            parser.set_features(reuse);
+        }
+
+        // parse the next element into element, false at the end or on an error
+        bool next(Value& element) {
+            if (error != PARSE_OK)
+                return false;
+            while (head == spans.size()) {
+                if (finished) {
+                    if (!root_checked)
+                        fail(PARSE_EXPECT_VALUE, buffer_begin + buffer.size());
+                    else if (!scanner.complete())
+                        fail(scanner.failed() ? PARSE_INVALID_VALUE : PARSE_MISS_COMMA_OR_SQUARE_BRAKET, buffer_begin + buffer.size());
+                    return false;
+                }
+                if (!fill())
+                    return false;
+            }
+            std::pair<size_t, size_t> span = spans[head++];
+            parser.set_json_source(buffer.data() + (span.first - buffer_begin), span.second - span.first, &element);
+            int ret = parser.parse();
+            if (ret != PARSE_OK) {
+                fail(ret, span.first + parser.get_error_offset());
+                return false;
+            }
+            consumed = span.second;
+            count++;
+            return true;
+        }
+
+        // PARSE_OK after a clean end
+        int getError() const {
+            return error;
+        }
+
+        // offset of the error in the whole input
+        size_t getErrorOffset() const {
+            return error_offset;
+        }
+
+        // elements handed out so far
+        size_t getIndex() const {
+            return count;
+        }
+    private:
+        // read one more chunk, dropping the text of the elements already handed out
+        bool fill() {
+            buffer.erase(0, consumed - buffer_begin);
+            buffer_begin = consumed;
+            spans.clear();
+            head = 0;
+            if (!source.read(chunk)) {
+                finished = true;
+                if (source.failed())
+                    fail(PARSE_INPUT_ERROR, buffer_begin + buffer.size());
+                return !source.failed();
+            }
+            if (!root_checked) {
+                size_t first = chunk.find_first_not_of(" \t\n\r");
+                if (first != std::string::npos) {
+                    root_checked = true;
+                    if (chunk[first] != '[') {
+                        fail(PARSE_TYPE_MISMATCH, buffer_begin + buffer.size() + first);
+                        return false;
+                    }
+                }
+            }
+            scanner.feed(chunk.data(), chunk.size(), [this](size_t begin, size_t end) {
+                spans.push_back(std::make_pair(begin, end));
+            });
+            buffer += chunk;
+            // the elements before a broken spot are still handed out
+            if (scanner.failed())
+                finished = true;
+            return true;
+        }
+
+        void fail(int ret, size_t offset) {
+            error = ret;
+            error_offset = offset;
+        }
+    private:
+        InputSource& source;
+        value_parse parser;
+        element_scanner scanner;
+        std::string chunk;
+        // input from buffer_begin on, elements before consumed were handed out
+        std::string buffer;
+        size_t buffer_begin = 0;
+        size_t consumed = 0;
+        std::vector<std::pair<size_t, size_t>> spans;
+        size_t head = 0;
+        size_t count = 0;
+        bool root_checked = false;
+        bool finished = false;
+        int error = PARSE_OK;
+        size_t error_offset = 0;
+    };
+
+    enum column_type {
+        COLUMN_DOUBLE,
+        COLUMN_INT64,
+        COLUMN_BOOL,
+        COLUMN_STRING
+    };
+
+    // one field of every record as a contiguous typed vector plus a validity bitmap;
+    // records without the field, or with null in it, are null rows. strings are kept
+    // back to back in chars(), row i is [offsets()[i], offsets()[i + 1])
+    class Column {
+    public:
+        Column(const std::string& _path, column_type _type) :field_path(_path), type(_type) {
+            offset_data.push_back(0);
+        }
+
+        // JSON Pointer of the field inside a record
+        const std::string& path() const {
+            return field_path;
+        }
+
+        column_type getType() const {
+            return type;
+        }
+
+        size_t size() const {
+            return rows;
+        }
+
+        bool isNull(size_t row) const {
+            assert(row < rows);
+            return ((validity[row >> 3] >> (row & 7)) & 1) == 0;
+        }
+
+        double asDouble(size_t row) const {
+            assert(type == COLUMN_DOUBLE && row < rows);
+            return double_data[row];
+        }
+
+        long long asInt(size_t row) const {
+            assert(type == COLUMN_INT64 && row < rows);
+            return int_data[row];
+        }
+
+        bool asBool(size_t row) const {
+            assert(type == COLUMN_BOOL && row < rows);
+            return bool_data[row] != 0;
+        }
+
+        std::string asString(size_t row) const {
+            assert(type == COLUMN_STRING && row < rows);
+            return char_data.substr(offset_data[row], offset_data[row + 1] - offset_data[row]);
+        }
+
+        // the whole column, null rows hold 0 / false / ""
+        const std::vector<double>& doubles() const {
+            return double_data;
+        }
+
+        const std::vector<long long>& ints() const {
+            return int_data;
+        }
+
+        const std::vector<unsigned char>& bools() const {
+            return bool_data;
+        }
+
+        const std::string& chars() const {
+            return char_data;
+        }
+
+        const std::vector<size_t>& offsets() const {
+            return offset_data;
+        }
+
+        // bit (row & 7) of byte (row >> 3) is set for a row with a value
+        const std::vector<unsigned char>& validityBitmap() const {
+            return validity;
+        }
+    private:
+        friend class column_parse;
+
+        // a row is added before its value is filled in, so it only takes the value
+        void add_row(bool valid) {
+            if ((rows & 7) == 0)
+                validity.push_back(0);
+            if (valid)
+                validity[rows >> 3] |= static_cast<unsigned char>(1 << (rows & 7));
+            switch (type) {
+            case COLUMN_DOUBLE: double_data.push_back(0); break;
+            case COLUMN_INT64: int_data.push_back(0); break;
+            case COLUMN_BOOL: bool_data.push_back(0); break;
+            case COLUMN_STRING: offset_data.push_back(char_data.size()); break;
             }
-            return ret;
+            rows++;
         }
 
-        int parse_string(std::string& tmp_str, std::string::const_iterator& tmp_it) {
-            char ch = 0;
-            tmp_it++;
-            while (tmp_it != json_source.end()) {
-                ch = *tmp_it++;
-                switch (ch) {
-                case '\"':
-                    return PARSE_OK;
-                case '\\':
-                    if (tmp_it != json_source.end()) {
-                        switch (*tmp_it++) {
-                        case '\"': tmp_str += '\"'; break;
-                        case 'n': tmp_str += '\n'; break;
-                        case 'r': tmp_str += '\r'; break;
-                        case 't': tmp_str += '\t'; break;
-                        case 'f': tmp_str += '\f'; break;
-                        case 'b': tmp_str += '\b'; break;
-                        case '/': tmp_str += '/'; break;
-                        case '\\': tmp_str += '\\'; break;
-                        case 'u': { 
-                            unsigned u = 0;
-                            int ret = 0;
-                            if ((ret = parse_hex4(tmp_it, u)) != PARSE_OK)
-                                return ret;
-                            if (u >= 0xD800 && u <= 0xDBFF) {
-                                CHECK_ITERATOR(tmp_it);
-                                if (*tmp_it++ != '\\')
-                                    return PARSE_INVALID_UNICODE_SURROGATE;
-                                CHECK_ITERATOR(tmp_it);
-                                if (*tmp_it++ != 'u')
-                                    return PARSE_INVALID_UNICODE_SURROGATE;
-                                unsigned tmp_u;
-                                if ((ret = parse_hex4(tmp_it, tmp_u)) != PARSE_OK)
-                                    return ret;
-                                if (tmp_u <0xDC00 || tmp_u > 0xDFFF)
-                                    return PARSE_INVALID_UNICODE_SURROGATE;
-                                u = 0x10000 + (u - 0xD800) * 0x400 + (tmp_u - 0xDC00);
-                            }
-                            if (u > 0x10FFFF)
-                                return PARSE_INVALID_UNICODE_HEX;
-                            encode_utf8(u, tmp_str);
+        // drop the rows of a record that failed half way
+        void truncate(size_t count) {
+            if (count >= rows)
+                return;
+            rows = count;
+            validity.resize((rows + 7) >> 3);
+            if (rows & 7)
+                validity.back() &= static_cast<unsigned char>((1 << (rows & 7)) - 1);
+            double_data.resize(std::min(double_data.size(), rows));
+            int_data.resize(std::min(int_data.size(), rows));
+            bool_data.resize(std::min(bool_data.size(), rows));
+            if (type == COLUMN_STRING) {
+                offset_data.resize(rows + 1);
+                char_data.resize(offset_data.back());
+            }
+        }
+    private:
+        std::string field_path;
+        column_type type;
+        size_t rows = 0;
+        std::vector<unsigned char> validity;
+        std::vector<double> double_data;
+        std::vector<long long> int_data;
+        std::vector<unsigned char> bool_data;
+        std::string char_data;
+        std::vector<size_t> offset_data;
+    };
+
+    // walks records with the lexer only, fields on a column path go straight into
+    // their Column and everything else is skipped, no Value is ever built
+    class column_parse : public json_lexer {
+    public:
+        void set_columns(std::vector<Column>* _columns) {
+            columns = _columns;
+            nodes.assign(1, path_node());
+            for (size_t i = 0; i < columns->size(); i++) {
+                size_t node = 0;
+                for (auto& e : split_pointer((*columns)[i].path())) {
+                    size_t child = find_child(node, e.data(), e.size());
+                    if (child == 0) {
+                        child = nodes.size();
+                        nodes.push_back(path_node());
+                        nodes.back().name = e;
+                        nodes[node].children.push_back(child);
+                    }
+                    node = child;
+                }
+                nodes[node].column = static_cast<int>(i);
+            }
+            filled.assign(columns->size(), 0);
+        }
+
+        // a root array of records
+        int parse_array(const std::string& source) {
+            set_source(source);
+            int ret = 0;
+            if ((ret = check_source()) != PARSE_OK)
+                return ret;
+            skip_blank();
+            if (it == json_source.end() || *it != '[')
+                ret = mismatch();
+            else {
+                it++;
+                skip_blank();
+                if (it != json_source.end() && *it == ']')
+                    it++;
+                else {
+                    for (;;) {
+                        skip_blank();
+                        if ((ret = parse_record()) != PARSE_OK)
+                            break;
+                        skip_blank();
+                        if (it != json_source.end() && *it == ',')
+                            it++;
+                        else if (it != json_source.end() && *it == ']') {
+                            it++;
                             break;
                         }
-                        default: return PARSE_INVALID_STRING_ESCAPE;
+                        else {
+                            ret = PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                            break;
                         }
                     }
-                    else
-                        return PARSE_MISS_QUOTATION_MARK;
-                    break;
-                case '\0':
-                    return PARSE_MISS_QUOTATION_MARK;
-                default:
-                    if (ch < 0x20)
-                        return PARSE_INVALID_STRING_CHAR;
-                    tmp_str += ch;
-                    break;
                 }
             }
-            return PARSE_MISS_QUOTATION_MARK;
+            return finish(ret);
         }
 
-        int parse_array(Value* element = nullptr) {
-            it++;
-            std::vector<Value> tmp_array;
+        // a single record, one NDJSON line
+        int parse_line(const std::string& source) {
+            set_source(source);
             int ret = 0;
+            if ((ret = check_source()) != PARSE_OK)
+                return ret;
             skip_blank();
-            if (*it == ']') {
-                it++;
-                if (element != nullptr)
-                    *element = tmp_array;
+            ret = parse_record();
+            return finish(ret);
+        }
+    private:
+        struct path_node {
+            std::string name;
+            std::vector<size_t> children;
+            int column = -1;
+        };
+
+        int finish(int ret) {
+            if (ret == PARSE_OK) {
+                skip_blank();
+                if (it != json_source.end())
+                    ret = PARSE_ROOT_NOT_SINGULAR;
+            }
+            if (ret != PARSE_OK)
+                error_offset = it - json_source.begin();
+            return ret;
+        }
+
+        // JSON Pointer to its unescaped parts
+        static std::vector<std::string> split_pointer(const std::string& path) {
+            std::vector<std::string> parts;
+            for (size_t i = 0; i < path.size(); i++) {
+                if (path[i] == '/') {
+                    parts.push_back(std::string());
+                    continue;
+                }
+                if (parts.empty())
+                    parts.push_back(std::string());
+                if (path[i] == '~' && i + 1 < path.size() && (path[i + 1] == '0' || path[i + 1] == '1'))
+                    parts.back() += path[++i] == '0' ? '~' : '/';
                 else
-                    *root = tmp_array;
+                    parts.back() += path[i];
+            }
+            return parts;
+        }
+
+        // 0 (the root, never a child) when there is none
+        size_t find_child(size_t node, const char* name, size_t length) const {
+            for (auto e : nodes[node].children) {
+                if (nodes[e].name.size() == length && memcmp(nodes[e].name.data(), name, length) == 0)
+                    return e;
+            }
+            return 0;
+        }
+
+        // one row for every column, the fields the record lacks are null
+        int parse_record() {
+            size_t rows = columns->empty() ? 0 : columns->front().size();
+            std::fill(filled.begin(), filled.end(), 0);
+            int ret = it != json_source.end() && *it == '{' ? parse_object(0) : mismatch();
+            for (size_t i = 0; i < columns->size() && ret == PARSE_OK; i++) {
+                if (!filled[i])
+                    (*columns)[i].add_row(false);
+            }
+            if (ret != PARSE_OK) {
+                for (auto& e : *columns)
+                    e.truncate(rows);
+            }
+            return ret;
+        }
+
+        int parse_object(size_t node) {
+            it++;
+            skip_blank();
+            if (it != json_source.end() && *it == '}') {
+                it++;
                 return PARSE_OK;
             }
-            while (it != json_source.end()) {
-                Value tmp_element;
+            int ret = 0;
+            for (;;) {
                 skip_blank();
-                if ((ret = parse_value(&tmp_element)) != PARSE_OK)
+                CHECK_ITERATOR(it);
+                if (*it != '\"')
+                    return PARSE_MISS_KEY;
+                key_buffer.clear();
+                std::string::const_iterator tmp_it = it;
+                if (parse_string(key_buffer, tmp_it) != PARSE_OK)
+                    return PARSE_MISS_KEY;
+                it = tmp_it;
+                skip_blank();
+                CHECK_ITERATOR(it);
+                if (*it != ':')
+                    return PARSE_MISS_COLON;
+                it++;
+                skip_blank();
+                CHECK_ITERATOR(it);
+                size_t child = find_child(node, key_buffer.data(), key_buffer.size());
+                // a repeated field keeps its first value
+                if (child != 0 && nodes[child].column >= 0 && !filled[nodes[child].column])
+                    ret = parse_field((*columns)[nodes[child].column], nodes[child].column);
+                else if (child != 0 && !nodes[child].children.empty() && *it == '{')
+                    ret = parse_object(child);
+                else if (child != 0 && !nodes[child].children.empty() && *it != 'n')
+                    ret = mismatch();
+                else
+                    ret = skip_value();
+                if (ret != PARSE_OK)
                     return ret;
                 skip_blank();
-                // insert element to array
-                tmp_array.push_back(tmp_element);
-                if (*it == ',') {
-                    CHECK_ITERATOR(it);
+                CHECK_ITERATOR(it);
+                if (*it == '}') {
                     it++;
+                    return PARSE_OK;
                 }
-                else if (*it == ']') {
-                    CHECK_ITERATOR(it);
-                    it++;
-                    break;
+                if (*it != ',')
+                    return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                it++;
+            }
+        }
+
+        int parse_field(Column& column, size_t index) {
+            filled[index] = 1;
+            if (*it == 'n') {
+                column.add_row(false);
+                return skip_literal("null");
+            }
+            std::string::const_iterator tmp_it = it;
+            int ret = PARSE_OK;
+            switch (column.type) {
+            case COLUMN_DOUBLE: {
+                if (!is_number())
+                    return mismatch();
+                if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                    return ret;
+                errno = 0;
+                double dst_number = strtod(&(*it), NULL);
+                if (errno == ERANGE && (dst_number == HUGE_VAL || dst_number == -HUGE_VAL))
+                    return PARSE_NUMBER_OVERFLOW;
+                column.add_row(true);
+                column.double_data.back() = dst_number;
+                break;
+            }
+            case COLUMN_INT64: {
+                if (!is_number())
+                    return mismatch();
+                if ((ret = scan_number(tmp_it)) != PARSE_OK)
+                    return ret;
+                for (std::string::const_iterator ct = it; ct != tmp_it; ct++) {
+                    if (*ct == '.' || *ct == 'e' || *ct == 'E')
+                        return PARSE_TYPE_MISMATCH;
                 }
-                else
-                    return PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                errno = 0;
+                long long dst_number = strtoll(&(*it), NULL, 10);
+                if (errno == ERANGE)
+                    return PARSE_NUMBER_OVERFLOW;
+                column.add_row(true);
+                column.int_data.back() = dst_number;
+                break;
             }
-            if (element != nullptr)
-                *element = tmp_array;
-            else
-                *root = tmp_array;
+            case COLUMN_BOOL: {
+                if (*it != 't' && *it != 'f')
+                    return mismatch();
+                bool boolean = *it == 't';
+                if ((ret = skip_literal(boolean ? "true" : "false")) != PARSE_OK)
+                    return ret;
+                column.add_row(true);
+                column.bool_data.back() = boolean;
+                return PARSE_OK;
+            }
+            case COLUMN_STRING:
+                if (*it != '\"')
+                    return mismatch();
+                // decoded straight behind the previous row's characters
+                if ((ret = parse_string(column.char_data, tmp_it)) != PARSE_OK) {
+                    column.char_data.resize(column.offset_data.back());
+                    return ret;
+                }
+                column.add_row(true);
+                column.offset_data.back() = column.char_data.size();
+                break;
+            }
+            it = tmp_it;
             return PARSE_OK;
         }
+    private:
+        std::vector<Column>* columns = nullptr;
+        std::vector<path_node> nodes;
+        std::vector<char> filled;
+        std::string key_buffer;
+    };
 
-        int parse_object(Value* element = nullptr) {
-            it++;
-            skip_blank();
+    // parses arrays of records or NDJSON streams straight into typed columns
+    class ColumnReader {
+    public:
+        ColumnReader() {}
+
+        explicit ColumnReader(const Features& features) {
+            parser.set_features(features);
+        }
+
+        // path is a JSON Pointer into each record ("/user/id"), returns the column number
+        size_t addColumn(const std::string& path, column_type type) {
+            assert(rows() == 0 && !path.empty() && path[0] == '/');
+            columns.push_back(Column(path, type));
+            parser.set_columns(&columns);
+            return columns.size() - 1;
+        }
+
+        const Column& column(size_t index) const {
+            return columns[index];
+        }
+
+        size_t columnCount() const {
+            return columns.size();
+        }
+
+        size_t rows() const {
+            return columns.empty() ? 0 : columns.front().size();
+        }
+
+        // append the records of a root array, a failing record adds no row
+        int parseArray(const std::string& document) {
+            int ret = parser.parse_array(document);
+            error_offset = parser.get_error_offset();
+            return ret;
+        }
+
+        // append one record per non blank line
+        int parseNdjson(InputSource& source) {
+            line_reader lines(source);
+            std::string line;
+            while (lines.next(line)) {
+                if (line_reader::blank(line))
+                    continue;
+                int ret = parser.parse_line(line);
+                if (ret != PARSE_OK) {
+                    error_offset = lines.begin() + parser.get_error_offset();
+                    return ret;
+                }
+            }
+            error_offset = 0;
+            return lines.failed() ? PARSE_INPUT_ERROR : PARSE_OK;
+        }
+
+        size_t getErrorOffset() const {
+            return error_offset;
+        }
+    private:
+        std::vector<Column> columns;
+        column_parse parser;
+        size_t error_offset = 0;
+    };
+
+    // reformat a JSON text without building a Value, keys keep their order; only
+    // strings, brackets and the separation of values are checked, the text is not
+    // validated as a whole
+    class text_format {
+    public:
+        static int minify(const std::string& source, std::string& result) {
+            result.clear();
+            result.reserve(source.size());
+            std::vector<char> stack;
+            const char* p = source.data();
+            const char* end = p + source.size();
             int ret = 0;
-            std::map<std::string, Value> tmp_object;
-            if (*it == '}') {
-                if (element != nullptr)
-                    *element = tmp_object;
-                else
-                    *root = tmp_object;
-                return PARSE_OK;
+            // last character written, 0 before the first
+            char last = 0;
+            while (p < end) {
+                const char* run = p;
+                p = find_structural(p, end);
+                if (p != run) {
+                    // a run only follows a value across blanks, or holds a second root value
+                    if (stack.empty() && (last != 0 || std::find_if(run, p, [](char e) {
+                            return e == ',' || e == ':'; }) != p))
+                        return PARSE_ROOT_NOT_SINGULAR;
+                    if (ends_value(last) && *run != ',' && *run != ':')
+                        return missing_separator(stack);
+                    result.append(run, p - run);
+                    last = p[-1];
+                }
+                if (p == end)
+                    break;
+                char ch = *p++;
+                switch (ch) {
+                case ' ': case '\t': case '\n': case '\r':
+                    break;
+                case '\"':
+                    if (ends_value(last))
+                        return missing_separator(stack);
+                    if ((ret = copy_string(p, end, result)) != PARSE_OK)
+                        return ret;
+                    last = ch;
+                    break;
+                default:
+                    if ((ch == '[' || ch == '{') && ends_value(last))
+                        return missing_separator(stack);
+                    if ((ret = check_bracket(ch, stack)) != PARSE_OK)
+                        return ret;
+                    result += ch;
+                    last = ch;
+                    break;
+                }
+            }
+            return finish(result, stack);
+        }
+
+        // same layout as StyleWriter: one member per line and " : " behind keys
+        static int prettify(const std::string& source, std::string& result, size_t indent) {
+            result.clear();
+            result.reserve(source.size() * 2);
+            std::vector<char> stack;
+            const char* p = source.data();
+            const char* end = p + source.size();
+            int ret = 0;
+            char last = 0;
+            bool blank = false;
+            while (p < end) {
+                char ch = *p++;
+                if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+                    blank = true;
+                    continue;
+                }
+                // a scalar goes on only while no blank, quote or bracket ended it
+                bool scalar = ch != '\"' && ch != '[' && ch != '{' && ch != ']' && ch != '}' && ch != ',' && ch != ':';
+                bool continued = scalar && !blank && last != '\"' && last != ']' && last != '}';
+                if ((ch == '\"' || ch == '[' || ch == '{' || scalar) && ends_value(last) && !continued)
+                    return missing_separator(stack);
+                if ((ch == ',' || ch == ':') && stack.empty())
+                    return PARSE_ROOT_NOT_SINGULAR;
+                blank = false;
+                last = ch;
+                switch (ch) {
+                case '\"':
+                    if ((ret = copy_string(p, end, result)) != PARSE_OK)
+                        return ret;
+                    break;
+                case '[': case '{': {
+                    check_bracket(ch, stack);
+                    result += ch;
+                    const char* next = skip_blank(p, end);
+                    // keep empty containers on one line
+                    if (next != end && (*next == ']' || *next == '}')) {
+                        if ((ret = check_bracket(*next, stack)) != PARSE_OK)
+                            return ret;
+                        result += *next;
+                        last = *next;
+                        p = next + 1;
+                        break;
+                    }
+                    new_line(result, stack.size() * indent);
+                    break;
+                }
+                case ']': case '}':
+                    if ((ret = check_bracket(ch, stack)) != PARSE_OK)
+                        return ret;
+                    new_line(result, stack.size() * indent);
+                    result += ch;
+                    break;
+                case ',':
+                    result += ch;
+                    new_line(result, stack.size() * indent);
+                    break;
+                case ':':
+                    result += " : ";
+                    break;
+                default:
+                    result += ch;
+                    break;
+                }
+            }
+            return finish(result, stack);
+        }
+    private:
+        // first whitespace, quote or bracket in [p, end)
+        static const char* find_structural(const char* p, const char* end) {
+#ifdef __SSE2__
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i line_feed = _mm_set1_epi8('\n');
+            const __m128i carriage_return = _mm_set1_epi8('\r');
+            const __m128i quote = _mm_set1_epi8('\"');
+            // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+            const __m128i lower = _mm_set1_epi8(0x20);
+            const __m128i open = _mm_set1_epi8('{');
+            const __m128i close = _mm_set1_epi8('}');
+            while (end - p >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i folded = _mm_or_si128(chunk, lower);
+                __m128i mask = _mm_or_si128(
+                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(chunk, line_feed), _mm_cmpeq_epi8(chunk, carriage_return))),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                 _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close))));
+                int bits = _mm_movemask_epi8(mask);
+                if (bits != 0)
+                    return p + __builtin_ctz(bits);
+                p += 16;
+            }
+#endif
+            for (; p < end; p++) {
+                switch (*p) {
+                case ' ': case '\t': case '\n': case '\r': case '\"':
+                case '[': case ']': case '{': case '}':
+                    return p;
+                default: break;
+                }
             }
-            for (;;) {
-                skip_blank();
-                CHECK_ITERATOR(it);
-                if (*it != '\"')
-                    return PARSE_MISS_KEY;
-                std::string key_str;
-                std::string::const_iterator tmp_it = it;
-                if ((ret = parse_string(key_str, tmp_it)) != PARSE_OK)
-                    return PARSE_MISS_KEY;
-                it = tmp_it;
-                skip_blank();
-                CHECK_ITERATOR(it);
-                if (*it != ':')
-                    return PARSE_MISS_COLON;
-                it++;
-                skip_blank();
-                CHECK_ITERATOR(it);
-                Value tmp_root;
-                if ((ret = parse_value(&tmp_root)) != PARSE_OK)
-                    return ret;
-                tmp_object.insert(make_pair(key_str, tmp_root));
-                skip_blank();
-                CHECK_ITERATOR(it);
-                if (*it == '}') {
-                    it++;
-                    if (element != nullptr)
-                        *element = tmp_object;
-                    else
-                        *root = tmp_object;
+            return p;
+        }
+
+        // p is behind the opening quote, copy up to and including the closing one
+        static int copy_string(const char*& p, const char* end, std::string& result) {
+            const char* begin = p;
+            while (p < end) {
+                if (*p == '\\')
+                    p += 2;
+                else if (*p++ == '\"') {
+                    result += '\"';
+                    result.append(begin, p - begin);
                     return PARSE_OK;
                 }
-                else if (*it == ',')
-                    it++;
-                else {
-                    return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-                }
             }
+            return PARSE_MISS_QUOTATION_MARK;
         }
 
-        int parse_hex4(std::string::const_iterator& tmp_it, unsigned& u) {
-            u = 0;
-            char ch = 0;
-            for (int i = 0; i < 4; i++) {
-                u <<= 4;
-                CHECK_ITERATOR(tmp_it);
-                ch = *tmp_it++;
-                if (ch >= '0' && ch <= '9')
-                    u |= ch - '0';
-                else if (ch >= 'a' && ch <= 'f')
-                    u |= ch - 'a' + 10;
-                else if (ch >= 'A' && ch <= 'F')
-                    u |= ch - 'A' + 10;
-                else return PARSE_INVALID_UNICODE_HEX;
+        static int check_bracket(char ch, std::vector<char>& stack) {
+            switch (ch) {
+            case '[': case '{':
+                stack.push_back(ch);
+                return PARSE_OK;
+            case ']':
+                if (stack.empty() || stack.back() != '[')
+                    return stack.empty() ? PARSE_ROOT_NOT_SINGULAR : PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                break;
+            default:
+                if (stack.empty() || stack.back() != '{')
+                    return stack.empty() ? PARSE_ROOT_NOT_SINGULAR : PARSE_MISS_COMMA_OR_SQUARE_BRAKET;
+                break;
             }
+            stack.pop_back();
             return PARSE_OK;
         }
 
-        void encode_utf8(unsigned& u, std::string& tmp_str) {
-            if (u <= 0x7F)
-                tmp_str += (u & 0xFF);
-            else if (u <= 0x7FF) {
-                tmp_str += (0xC0 | (0xFF & (u >> 6)));
-                tmp_str += (0x80 | (0x3F & u));
-            }
-            else if (u <= 0xffff) {
-                tmp_str += (0xE0 | (0xFF & (u >> 12)));
-                tmp_str += (0x80 | (0x3F & (u >> 6)));
-                tmp_str += (0x80 | (0x3F & u));
-            }
-            else {
-                tmp_str += (0xF0 | (0xFF & (u >> 18)));
-                tmp_str += (0x80 | (0x3F & (u >> 12)));
-                tmp_str += (0x80 | (0x3F & (u >> 6)));
-                tmp_str += (0x80 | (0x3F & u));
-            }    
+        // something that closes a value was written last
+        static bool ends_value(char last) {
+            return last != 0 && last != ',' && last != ':' && last != '[' && last != '{';
         }
-    private:
-        std::string json_source;
-        std::string::const_iterator it;
-        Value* root;
-    };
 
-    class json_parser : public value_parse {
-    private:
-        json_parser() {}
-    public:
-        static json_parser* get_parser(const std::string& source, Value* v){
-            static json_parser singleton_parser;
-            singleton_parser.set_json_source(source, v);
-            // use singleton create parser
-            return &singleton_parser;
+        // two values with nothing between them
+        static int missing_separator(const std::vector<char>& stack) {
+            if (stack.empty())
+                return PARSE_ROOT_NOT_SINGULAR;
+            return stack.back() == '[' ? PARSE_MISS_COMMA_OR_SQUARE_BRAKET : PARSE_MISS_COMMA_OR_CURLY_BRACKET;
         }
 
-        json_parser(const json_parser& ban_parser) = delete;
+        static int finish(const std::string& result, const std::vector<char>& stack) {
+            if (result.empty())
+                return PARSE_EXPECT_VALUE;
+            if (!stack.empty())
+                return stack.back() == '[' ? PARSE_MISS_COMMA_OR_SQUARE_BRAKET : PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            return PARSE_OK;
+        }
+
+        static const char* skip_blank(const char* p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+            return p;
+        }
 
-        json_parser& operator=(const json_parser& ban_parser) = delete;
+        static void new_line(std::string& result, size_t spaces) {
+            result += '\n';
+            result.append(spaces, ' ');
+        }
     };
 
-    class Reader {
+    inline int minify(const std::string& source, std::string& result) {
+        return text_format::minify(source, result);
+    }
+
+    inline int prettify(const std::string& source, std::string& result, size_t indent = 4) {
+        return text_format::prettify(source, result, indent);
+    }
+
+    // escaping and number formatting shared by every writer, appends to out
+    class json_escape {
     public:
-        static int parse(const std::string document, Value& root) {
-            json_parser* parser = json_parser::get_parser(document, &root);
-            int ret = parser->parse();
-            parser = nullptr;
-            return ret;
+        static void append_number(std::string& out, double number) {
+            char buf[50];
+            int length = snprintf(buf, sizeof(buf), "%.17g", number);
+            out.append(buf, length);
+        }
+
+        static void append_string(std::string& out, const char* data, size_t length) {
+            out += '\"';
+            for (size_t i = 0; i < length; i++) {
+                char e = data[i];
+                switch (e) {
+                    case '\\': out += "\\\\"; break;
+                    case '\"': out += "\\\""; break;
+                    case '\b': out += "\\b"; break;
+                    case '\f': out += "\\f"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                    if (static_cast<unsigned char>(e) < 0x20) {
+                        char buf[7];
+                        snprintf(buf, sizeof(buf), "\\u%04x", e);
+                        out += buf;
+                    }
+                    else
+                    out += e;
+                    break;
+                }
+            }
+            out += '\"';
         }
     };
 
@@ -638,59 +4612,52 @@ namespace JSON {
     public:
         virtual std::string write(const Value& root) = 0;
     protected:
-        virtual std::string convert_object(const Value& root) = 0;
+        // every level appends to the one output, so deep trees are not copied once per level
+        virtual void convert_object(const Value& root, std::string& out) = 0;
 
-        virtual std::string convert_array(const Value& root) = 0;
+        virtual void convert_array(const Value& root, std::string& out) = 0;
 
-        std::string convert_value(const Value& root) {
+        void convert_value(const Value& root, std::string& out) {
             switch (root.get_type()) {
-                case JSON_NULL: return convert_literal(root.get_type()); break;
-                case JSON_TRUE: return convert_literal(root.get_type()); break;
-                case JSON_FALSE: return convert_literal(root.get_type()); break;
-                case JSON_NUMBER: return convert_number(root.asDouble()); break;
-                case JSON_STRING: return convert_string(root.asString()); break;
-                case JSON_ARRAY: return convert_array(root); break;
-                case JSON_OBJECT: return convert_object(root); break;
+                case JSON_NULL: out += "null"; break;
+                case JSON_TRUE: out += "true"; break;
+                case JSON_FALSE: out += "false"; break;
+                case JSON_NUMBER: {
+                    size_t length = 0;
+                    const char* text = root.raw_number(length);
+                    if (text != nullptr)
+                        out.append(text, length);
+                    else
+                        json_escape::append_number(out, root.asDouble());
+                    break;
+                }
+                case JSON_STRING: {
+                    const std::string& str = *root.str;
+                    json_escape::append_string(out, str.data(), str.size());
+                    break;
+                }
+                case JSON_ARRAY: convert_array(root, out); break;
+                default: convert_object(root, out); break;
             }
         }
-    private:
+
         std::string convert_literal(json_type type) {
             switch (type) {
-                case JSON_NULL: return std::string("null");
                 case JSON_TRUE: return std::string("true");
                 case JSON_FALSE: return std::string("false");
+                default: return std::string("null");
             }
         }
 
         std::string convert_number(const double& number) {
-            char buf[50];
-            sprintf(buf, "%.17g", number);
-            return std::string(buf);
+            std::string tmp_str;
+            json_escape::append_number(tmp_str, number);
+            return tmp_str;
         }
 
         std::string convert_string(const std::string& str) {
-            std::string tmp_str = "\"";
-            for (auto e : str) {
-                switch (e) {
-                    case '\\': tmp_str += "\\\\"; break;
-                    case '\"': tmp_str += "\\\""; break;
-                    case '\b': tmp_str += "\\b"; break;
-                    case '\f': tmp_str += "\\f"; break;
-                    case '\n': tmp_str += "\\n"; break;
-                    case '\r': tmp_str += "\\r"; break;
-                    case '\t': tmp_str += "\\t"; break;
-                    default:
-                    if (e < 0x20) {
-                        char buf[7];
-                        sprintf(buf, "\\u%04x", e);
-                        tmp_str += buf;
-                    }
-                    else
-                    tmp_str += e;
-                    break;
-                }
-            }
-            tmp_str += '\"';
+            std::string tmp_str;
+            json_escape::append_string(tmp_str, str.data(), str.size());
             return tmp_str;
         }
     };
@@ -698,42 +4665,244 @@ namespace JSON {
     class FastWriter : public Writer {
     public:
         std::string write(const Value& root) {
-            return convert_value(root);
+            std::string tmp_str;
+            convert_value(root, tmp_str);
+            return tmp_str;
+        }
+
+        // arrays and objects with at least threshold children are written in chunks
+        // on thread_count workers, the output is the same as the sequential one
+        void enableParallel(size_t thread_count, size_t threshold = 4096) {
+            pool = std::make_shared<task_pool>(thread_count);
+            parallel_threshold = threshold == 0 ? 1 : threshold;
+        }
+
+        // write a type described by JSON_BIND, members keep their declaration order
+        template <typename T>
+        std::string write(const T& object) {
+            std::string tmp_str;
+            convert_bound(object, tmp_str);
+            return tmp_str;
         }
     private:
-        std::string convert_array(const Value& root) {
-            std::string tmp_str("[ ");
+        void convert_array(const Value& root, std::string& out) {
+            if (root.size() == 0) {
+                out += "[]";
+                return;
+            }
+            if (root.isPacked())
+                return convert_packed(root.packedNumbers(), out);
+            if (pool && root.size() >= parallel_threshold)
+                return convert_parallel(root, std::vector<Value::const_iterator>(), out);
+            out += "[ ";
             for (size_t i = 0; i < root.size(); i++) {
-                tmp_str += convert_value(root[i]);
-                tmp_str +=" , ";
+                convert_value(root[i], out);
+                out += " , ";
             }
-            tmp_str.pop_back();
-            tmp_str.pop_back();
-            tmp_str += "]";
-            return tmp_str;
+            out.pop_back();
+            out.pop_back();
+            out += "]";
+        }
+
+        void convert_object(const Value& root, std::string& out) {
+            if (root.size() == 0) {
+                out += "{}";
+                return;
+            }
+            if (pool && root.size() >= parallel_threshold) {
+                std::vector<Value::const_iterator> members;
+                members.reserve(root.size());
+                for (auto mt = root.begin(); mt != root.end(); ++mt)
+                    members.push_back(mt);
+                return convert_parallel(root, members, out);
+            }
+            out += "{ ";
+            for (auto mt = root.begin(); mt != root.end(); ++mt) {
+                json_escape::append_string(out, mt.name().data(), mt.name().size());
+                out += " : ";
+                convert_value(*mt, out);
+                out += " , ";
+            }
+            out.pop_back();
+            out.pop_back();
+            out += "}";
         }
 
-        std::string convert_object(const Value& root) {
-            std::string tmp_str("{ ");
-            std::vector<std::string> names = root.getMemberNames();
-            for (auto it : names) {
-                tmp_str += it;
-                tmp_str += " : ";
-                tmp_str += convert_value(root[it]);
-                tmp_str += " , ";
+        // children [begin, end) joined by " , ", members is empty for arrays
+        std::string convert_range(const Value& root, const std::vector<Value::const_iterator>& members,
+                                  size_t begin, size_t end) {
+            std::string tmp_str;
+            for (size_t i = begin; i < end; i++) {
+                if (i != begin)
+                    tmp_str += " , ";
+                if (members.empty())
+                    convert_value(root[i], tmp_str);
+                else {
+                    json_escape::append_string(tmp_str, members[i].name().data(), members[i].name().size());
+                    tmp_str += " : ";
+                    convert_value(*members[i], tmp_str);
+                }
             }
-            tmp_str.pop_back();
-            tmp_str.pop_back();
-            tmp_str += "}";
             return tmp_str;
         }
+
+        // packed numbers are formatted straight from their buffer
+        void convert_packed(const std::vector<double>& numbers, std::string& out) {
+            out += "[ ";
+            for (auto e : numbers) {
+                json_escape::append_number(out, e);
+                out += " , ";
+            }
+            out.pop_back();
+            out.pop_back();
+            out += "]";
+        }
+
+        void convert_parallel(const Value& root, const std::vector<Value::const_iterator>& members, std::string& out) {
+            size_t count = root.size();
+            size_t chunk_count = std::min(count, pool->size() * 4);
+            size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+            // the chunks run on sequential writers, nested containers are not split again
+            std::vector<std::future<std::string>> chunks;
+            for (size_t begin = chunk_size; begin < count; begin += chunk_size) {
+                size_t end = std::min(begin + chunk_size, count);
+                chunks.push_back(pool->submit([&root, &members, begin, end] {
+                    FastWriter writer;
+                    return writer.convert_range(root, members, begin, end);
+                }));
+            }
+            out += members.empty() ? "[ " : "{ ";
+            FastWriter writer;
+            out += writer.convert_range(root, members, 0, std::min(chunk_size, count));
+            for (auto& chunk : chunks) {
+                out += " , ";
+                out += chunk.get();
+            }
+            out += members.empty() ? " ]" : " }";
+        }
+
+        // like the Value writer, every level of a bound type appends to the one output
+        void convert_bound(bool object, std::string& out) {
+            out += object ? "true" : "false";
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type convert_bound(T object, std::string& out) {
+            json_escape::append_number(out, object);
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+        convert_bound(T object, std::string& out) {
+            char buf[24];
+            int length = 0;
+            if (std::is_signed<T>::value)
+                length = snprintf(buf, sizeof(buf), "%lld", (long long)object);
+            else
+                length = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)object);
+            out.append(buf, length);
+        }
+
+        void convert_bound(const std::string& object, std::string& out) {
+            json_escape::append_string(out, object.data(), object.size());
+        }
+
+        void convert_bound(const char* object, std::string& out) {
+            json_escape::append_string(out, object, strlen(object));
+        }
+
+        void convert_bound(const Value& object, std::string& out) {
+            convert_value(object, out);
+        }
+
+        template <typename T, typename Alloc>
+        void convert_bound(const std::vector<T, Alloc>& object, std::string& out) {
+            if (object.empty()) {
+                out += "[]";
+                return;
+            }
+            out += "[ ";
+            for (size_t i = 0; i < object.size(); i++) {
+                if (i != 0)
+                    out += " , ";
+                convert_bound(static_cast<const T&>(object[i]), out);
+            }
+            out += " ]";
+        }
+
+        template <typename T, typename Compare, typename Alloc>
+        void convert_bound(const std::map<std::string, T, Compare, Alloc>& object, std::string& out) {
+            if (object.empty()) {
+                out += "{}";
+                return;
+            }
+            out += "{ ";
+            bool first = true;
+            for (auto& e : object) {
+                if (!first)
+                    out += " , ";
+                first = false;
+                json_escape::append_string(out, e.first.data(), e.first.size());
+                out += " : ";
+                convert_bound(e.second, out);
+            }
+            out += " }";
+        }
+
+#if __cplusplus >= 201703L
+        template <typename T>
+        void convert_bound(const std::optional<T>& object, std::string& out) {
+            if (!object)
+                out += "null";
+            else
+                convert_bound(*object, out);
+        }
+#endif
+
+        struct member_writer {
+            member_writer(FastWriter* _writer, std::string& _out) :writer(_writer), out(_out) {}
+
+            template <typename T>
+            bool operator()(const char* name, size_t length, const T& member) {
+                if (!first)
+                    out += " , ";
+                first = false;
+                json_escape::append_string(out, name, length);
+                out += " : ";
+                writer->convert_bound(member, out);
+                return true;
+            }
+
+            FastWriter* writer;
+            std::string& out;
+            bool first = true;
+        };
+
+        template <typename T>
+        typename std::enable_if<std::is_class<T>::value>::type convert_bound(const T& object, std::string& out) {
+            size_t begin = out.size();
+            out += "{ ";
+            member_writer visitor(this, out);
+            Binding<T>::visit(visitor, object);
+            if (visitor.first) {
+                out.resize(begin);
+                out += "{}";
+            }
+            else
+                out += " }";
+        }
+    private:
+        std::shared_ptr<task_pool> pool;
+        size_t parallel_threshold = 4096;
     };
 
     class StyleWriter : public Writer {
     public:
         std::string write(const Value& root) {
             tab_count = 0;
-            return convert_value(root);
+            std::string tmp_str;
+            convert_value(root, tmp_str);
+            return tmp_str;
         }
     private:
 #define PUSH_TAB(str)\
@@ -742,63 +4911,284 @@ namespace JSON {
                 str += "    ";\
         } while(0)
 
-        std::string convert_array(const Value& root) {
-            std::string tmp_str;
-            tmp_str += "[\n";
+        void convert_array(const Value& root, std::string& out) {
+            if (root.size() == 0) {
+                out += "[]";
+                return;
+            }
+            out += "[\n";
             tab_count++;
+            // checked once, both walk the elements of an exposed packed array
+            const std::vector<double>* numbers = root.isPacked() ? &root.packedNumbers() : nullptr;
             for (size_t i = 0; i < root.size(); i++) {
-                PUSH_TAB(tmp_str);
-                tmp_str += convert_value(root[i]);
+                PUSH_TAB(out);
+                if (numbers != nullptr)
+                    json_escape::append_number(out, (*numbers)[i]);
+                else
+                    convert_value(root[i], out);
                 if (i + 1 != root.size())
-                    tmp_str += ",\n";
+                    out += ",\n";
                 else {
-                    tmp_str += '\n';
+                    out += '\n';
                     tab_count--;
                 }
             }
-            PUSH_TAB(tmp_str);
-            tmp_str += ']';
-            return tmp_str;
+            PUSH_TAB(out);
+            out += ']';
         }
 
-        std::string convert_object(const Value& root) {
-            std::string tmp_str;
-            tmp_str += "{\n";
+        void convert_object(const Value& root, std::string& out) {
+            if (root.size() == 0) {
+                out += "{}";
+                return;
+            }
+            out += "{\n";
             tab_count++;
-            std::vector<std::string> names = root.getMemberNames();
-            for (size_t i = 0; i < names.size(); i++) {
-                PUSH_TAB(tmp_str);
-                tmp_str += names[i];
-                tmp_str += " : ";
-                tmp_str += convert_value(root[names[i]]);
-                if (i + 1 != names.size())
-                    tmp_str += ",\n";
+            size_t i = 0;
+            for (auto mt = root.begin(); mt != root.end(); ++mt, ++i) {
+                PUSH_TAB(out);
+                json_escape::append_string(out, mt.name().data(), mt.name().size());
+                out += " : ";
+                convert_value(*mt, out);
+                if (i + 1 != root.size())
+                    out += ",\n";
                 else {
                     tab_count--;
-                    tmp_str += '\n';
+                    out += '\n';
                 }
             }
-            PUSH_TAB(tmp_str);
-            tmp_str += '}';
-            return tmp_str;
+            PUSH_TAB(out);
+            out += '}';
         }
     private:
         size_t tab_count = 0;
     };
 
+    // writes JSON as it is produced, without a Value tree: into a string, or into a
+    // file descriptor through a buffer of buffer_size bytes; the output is compact
+    // and the nesting is checked with assert
+    class StreamWriter {
+    public:
+        explicit StreamWriter(std::string& _out) :out(&_out) {}
+
+#ifdef JSON_HAS_POSIX
+        explicit StreamWriter(int _fd, size_t _buffer_size = 1 << 16)
+            :out(&buffer), fd(_fd), buffer_size(_buffer_size == 0 ? 1 : _buffer_size) {
+            buffer.reserve(buffer_size);
+        }
+#endif
+
+        ~StreamWriter() {
+            flush();
+        }
+
+        StreamWriter(const StreamWriter&) = delete;
+
+        StreamWriter& operator=(const StreamWriter&) = delete;
+
+        void startObject() {
+            before_value();
+            *out += '{';
+            scopes.push_back('{');
+            first = true;
+        }
+
+        void endObject() {
+            assert(!scopes.empty() && scopes.back() == '{' && !after_key);
+            end_scope('}');
+        }
+
+        void startArray() {
+            before_value();
+            *out += '[';
+            scopes.push_back('[');
+            first = true;
+        }
+
+        void endArray() {
+            assert(!scopes.empty() && scopes.back() == '[');
+            end_scope(']');
+        }
+
+        void key(const char* name, size_t length) {
+            assert(!scopes.empty() && scopes.back() == '{' && !after_key);
+            if (!first)
+                *out += ',';
+            first = false;
+            json_escape::append_string(*out, name, length);
+            *out += ':';
+            after_key = true;
+        }
+
+        void key(const std::string& name) {
+            key(name.data(), name.size());
+        }
+
+        void key(const char* name) {
+            key(name, strlen(name));
+        }
+
+        void nullValue() {
+            before_value();
+            *out += "null";
+            after_value();
+        }
+
+        void boolValue(bool boolean) {
+            before_value();
+            *out += boolean ? "true" : "false";
+            after_value();
+        }
+
+        // exact for every 64 bit integer, unlike a double
+        void intValue(long long number) {
+            before_value();
+            char buf[24];
+            out->append(buf, snprintf(buf, sizeof(buf), "%lld", number));
+            after_value();
+        }
+
+        void doubleValue(double number) {
+            before_value();
+            json_escape::append_number(*out, number);
+            after_value();
+        }
+
+        void stringValue(const char* str, size_t length) {
+            before_value();
+            json_escape::append_string(*out, str, length);
+            after_value();
+        }
+
+        void stringValue(const std::string& str) {
+            stringValue(str.data(), str.size());
+        }
+
+        void stringValue(const char* str) {
+            stringValue(str, strlen(str));
+        }
+
+        // a whole subtree
+        void value(const Value& root) {
+            switch (root.get_type()) {
+            case JSON_NULL: nullValue(); break;
+            case JSON_TRUE: boolValue(true); break;
+            case JSON_FALSE: boolValue(false); break;
+            case JSON_NUMBER:
+                if (root.hasRawNumber()) {
+                    size_t length = 0;
+                    const char* text = root.raw_number(length);
+                    before_value();
+                    out->append(text, length);
+                    after_value();
+                }
+                else
+                    doubleValue(root.asDouble());
+                break;
+            case JSON_STRING: stringValue(root.asString()); break;
+            case JSON_ARRAY:
+                startArray();
+                if (root.isPacked()) {
+                    for (auto e : root.packedNumbers())
+                        doubleValue(e);
+                }
+                else {
+                    for (auto& e : root)
+                        value(e);
+                }
+                endArray();
+                break;
+            default:
+                startObject();
+                for (auto mt = root.begin(); mt != root.end(); ++mt) {
+                    key(mt.name());
+                    value(*mt);
+                }
+                endObject();
+                break;
+            }
+        }
+
+        // hand the buffer to the file descriptor, false once a write failed
+        bool flush() {
+            if (fd < 0 || error)
+                return !error;
+#ifdef JSON_HAS_POSIX
+            size_t offset = 0;
+            while (offset < buffer.size()) {
+                ssize_t length = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+                if (length < 0 && errno == EINTR)
+                    continue;
+                if (length <= 0) {
+                    error = true;
+                    break;
+                }
+                offset += length;
+            }
+#endif
+            buffer.clear();
+            return !error;
+        }
+
+        bool failed() const {
+            return error;
+        }
+    private:
+        void before_value() {
+            if (scopes.empty()) {
+                assert(first);
+                first = false;
+            }
+            else if (scopes.back() == '[') {
+                if (!first)
+                    *out += ',';
+                first = false;
+            }
+            else {
+                assert(after_key);
+                after_key = false;
+            }
+        }
+
+        void after_value() {
+            if (fd >= 0 && buffer.size() >= buffer_size)
+                flush();
+        }
+
+        void end_scope(char bracket) {
+            *out += bracket;
+            scopes.pop_back();
+            first = false;
+            after_value();
+        }
+    private:
+        std::string buffer;
+        std::string* out;
+        int fd = -1;
+        size_t buffer_size = 0;
+        // open brackets, its size is the depth
+        std::string scopes;
+        bool first = true;
+        bool after_key = false;
+        bool error = false;
+    };
+
     std::string Value::asString() const {
         switch (type) {
         case JSON_NULL: return std::string("null");
         case JSON_TRUE: return std::string("true");
         case JSON_FALSE: return std::string("false");
-        case JSON_STRING: return str;
-        case JSON_ARRAY: return fw->write(*this);
-        case JSON_OBJECT: return fw->write(*this);
+        case JSON_STRING: return *str;
+        default: {
+            FastWriter fw;
+            return fw.write(*this);
+        }
         }
     }
 
     std::string Value::toStyledString() const {
-        sw->write(*this);
+        StyleWriter sw;
+        return sw.write(*this);
     }
 
 };
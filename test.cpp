@@ -2,7 +2,49 @@
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <new>
+#include <atomic>
 #include "json.hpp"
+#ifdef JSON_HAS_POSIX
+#include <unistd.h>
+#endif
+
+// counts heap allocations so tests can check that a path does not allocate; pool
+// threads of the parallel tests allocate at the same time, so it is atomic
+static std::atomic<size_t> allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+struct Point {
+    double x;
+    double y;
+};
+
+struct Shape {
+    std::string name;
+    int id;
+    bool visible;
+    std::vector<Point> points;
+    std::map<std::string, int> tags;
+    JSON::Value extra;
+};
+
+JSON_BIND(Point, x, y)
+JSON_BIND(Shape, name, id, visible, points, tags, extra)
 
 using namespace std;
 using namespace JSON;
@@ -248,6 +290,1278 @@ static void test_parse_invalid_unicode_surrogate() {
     TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
 }
 
+static void test_bind() {
+    Reader reader;
+    Shape shape;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"name\" : \"tri\", \"id\" : 7, \"visible\" : true, "
+                                         "\"unknown\" : [ 1, { \"a\" : null } ], "
+                                         "\"points\" : [ { \"x\" : 1.5, \"y\" : -2 }, { \"y\" : 3, \"x\" : 0 } ], "
+                                         "\"tags\" : { \"a\" : 1, \"b\" : 2 }, "
+                                         "\"extra\" : { \"k\" : \"v\" } }", shape));
+    EXPECT_EQ_STRING("tri", shape.name);
+    Point origin;
+    EXPECT_EQ_INT(PARSE_OK, Reader::parse("{ \"x\" : 1, \"y\" : 2 }", origin));
+    EXPECT_EQ_DOUBLE(2.0, origin.y);
+    EXPECT_EQ_INT(7, shape.id);
+    EXPECT_EQ_INT(true, shape.visible);
+    EXPECT_EQ_SIZE_T(2, shape.points.size());
+    EXPECT_EQ_DOUBLE(1.5, shape.points[0].x);
+    EXPECT_EQ_DOUBLE(-2.0, shape.points[0].y);
+    EXPECT_EQ_DOUBLE(3.0, shape.points[1].y);
+    EXPECT_EQ_INT(2, shape.tags["b"]);
+    EXPECT_EQ_STRING("v", shape.extra["k"].asString());
+
+    FastWriter fw;
+    string str = fw.write(shape);
+    EXPECT_EQ_STRING("{ \"name\" : \"tri\" , \"id\" : 7 , \"visible\" : true , "
+                     "\"points\" : [ { \"x\" : 1.5 , \"y\" : -2 } , { \"x\" : 0 , \"y\" : 3 } ] , "
+                     "\"tags\" : { \"a\" : 1 , \"b\" : 2 } , \"extra\" : { \"k\" : \"v\" } }", str);
+    Shape copy;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(str, copy));
+    EXPECT_EQ_STRING(str, fw.write(copy));
+
+    Point point;
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.read("{ \"x\" : \"1\" }", point));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.read("[ 1 ]", point));
+    EXPECT_EQ_INT(PARSE_MISS_COLON, reader.read("{ \"x\" 1 }", point));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, reader.read("{ } x", point));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.read("{ \"id\" : 1.5 }", shape));
+    EXPECT_EQ_INT(PARSE_NUMBER_OVERFLOW, reader.read("{ \"id\" : 12345678901234 }", shape));
+
+    vector<int> numbers;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[ 1, 2, 3 ]", numbers));
+    EXPECT_EQ_SIZE_T(3, numbers.size());
+    EXPECT_EQ_STRING("[ 1 , 2 , 3 ]", fw.write(numbers));
+
+    // every level and member appends to one output, nothing is built per point
+    vector<vector<Point>> rows(2, vector<Point>(1000, Point{ 1, 2 }));
+    rows[0].clear();
+    std::string expected = "[ [] , [ ";
+    for (int i = 0; i < 1000; i++)
+        expected += i == 0 ? "{ \"x\" : 1 , \"y\" : 2 }" : " , { \"x\" : 1 , \"y\" : 2 }";
+    expected += " ] ]";
+    size_t allocations = allocation_count;
+    std::string written = fw.write(rows);
+    EXPECT_EQ_INT(true, (allocation_count - allocations < 64));
+    EXPECT_EQ_STRING(expected, written);
+#if __cplusplus >= 201703L
+    std::optional<int> maybe = 1;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("null", maybe));
+    EXPECT_EQ_INT(false, maybe.has_value());
+    EXPECT_EQ_INT(PARSE_OK, reader.read("5", maybe));
+    EXPECT_EQ_INT(5, *maybe);
+#endif
+}
+
+static void test_equal_and_diff() {
+    Reader reader;
+    Value a, b;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"n\" : null, \"i\" : 1, \"s\" : \"x\", \"a\" : [ 1, 2, 3 ], \"o\" : { \"k\" : true } }", a));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"o\" : { \"k\" : true }, \"a\" : [ 1, 2, 3 ], \"s\" : \"x\", \"i\" : 1, \"n\" : null }", b));
+    EXPECT_EQ_INT(true, (a == b));
+    EXPECT_EQ_SIZE_T(a.hash(), b.hash());
+    EXPECT_EQ_SIZE_T(0, diff(a, b).size());
+
+    size_t old_hash = b.hash();
+    b["o"]["k"] = false;
+    EXPECT_EQ_INT(true, (a != b));
+    EXPECT_EQ_INT(true, (old_hash != b.hash()));
+
+    // a write through a held child leaves the parent's cached hash stale, == must not trust it
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"o\" : { \"k\" : true } }", a));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"o\" : { \"k\" : false } }", b));
+    Value& child = a["o"];
+    a.hash();
+    b.hash();
+    child["k"] = false;
+    EXPECT_EQ_INT(true, (a == b));
+
+    Value zero(0.0), negative_zero(-0.0);
+    EXPECT_EQ_INT(true, (zero == negative_zero));
+    EXPECT_EQ_SIZE_T(zero.hash(), negative_zero.hash());
+
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : [ 1, 2, 3 ], \"b/c\" : 1, \"keep\" : { \"x\" : [ 1 ] } }", a));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : [ 1, 5 ], \"d~\" : \"new\", \"keep\" : { \"x\" : [ 1 ] } }", b));
+    FastWriter fw;
+    EXPECT_EQ_STRING("[ { \"op\" : \"replace\" , \"path\" : \"/a/1\" , \"value\" : 5 } , "
+                     "{ \"op\" : \"remove\" , \"path\" : \"/a/2\" } , "
+                     "{ \"op\" : \"remove\" , \"path\" : \"/b~1c\" } , "
+                     "{ \"op\" : \"add\" , \"path\" : \"/d~0\" , \"value\" : \"new\" } ]", fw.write(diff(a, b)));
+}
+
+static void test_copy_on_write() {
+    Reader reader;
+    Value a;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : [ 1, 2 ], \"o\" : { \"s\" : \"x\" } }", a));
+    Value b = a;
+    EXPECT_EQ_INT(true, (a == b));
+    b["o"]["s"] = "y";
+    b["a"][0] = 9.0;
+    EXPECT_EQ_STRING("x", a["o"]["s"].asString());
+    EXPECT_EQ_DOUBLE(1.0, a["a"][0].asDouble());
+    EXPECT_EQ_STRING("y", b["o"]["s"].asString());
+    EXPECT_EQ_DOUBLE(9.0, b["a"][0].asDouble());
+
+    const Value c = a;
+    Value member = c["a"];
+    member.append(Value(3.0));
+    EXPECT_EQ_SIZE_T(2, a["a"].size());
+    EXPECT_EQ_SIZE_T(3, member.size());
+
+    Value d;
+    d = a;
+    a.removeMember("o");
+    EXPECT_EQ_INT(true, d.isMember("o"));
+    EXPECT_EQ_INT(false, a.isMember("o"));
+    d = Value("str");
+    EXPECT_EQ_STRING("str", d.asString());
+
+    // a moved-from value is null and safe to query
+    Value moved(std::move(b));
+    EXPECT_EQ_INT(JSON_NULL, b.get_type());
+    EXPECT_EQ_INT(false, b.isMember("o"));
+    EXPECT_EQ_INT(true, (b.find("o") == nullptr));
+    EXPECT_EQ_STRING("y", moved["o"]["s"].asString());
+    Value array_moved(std::move(moved["a"]));
+    EXPECT_EQ_INT(JSON_NULL, moved["a"].get_type());
+    EXPECT_EQ_SIZE_T(2, array_moved.size());
+
+    // a held reference never writes into a copy made after it was handed out
+    Value held;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"x\" : 1, \"n\" : { \"y\" : 1 }, \"a\" : [ 1, [ 1 ] ] }", held));
+    Value& x = held["x"];
+    Value& y = held["n"]["y"];
+    Value& element = held["a"][0];
+    Value& inner = held["a"][1][0];
+    Value copy = held;
+    Value assigned;
+    assigned = held;
+    x = 2.0;
+    y = 2.0;
+    element = 2.0;
+    inner = 2.0;
+    EXPECT_EQ_DOUBLE(2.0, held["x"].asDouble());
+    EXPECT_EQ_DOUBLE(2.0, held["a"][1][0].asDouble());
+    const Value& view = copy;
+    EXPECT_EQ_DOUBLE(1.0, view["x"].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, view["n"]["y"].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, view["a"][0].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, view["a"][1][0].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, assigned["x"].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, assigned["a"][1][0].asDouble());
+    for (auto& e : held["a"])
+        e = 3.0;
+    Value after = held;
+    held["a"][0] = 4.0;
+    EXPECT_EQ_DOUBLE(3.0, after["a"][0].asDouble());
+
+    // the same for the elements of a packed array
+    std::string text = "[ 0";
+    for (int i = 1; i < 20; i++)
+        text += ", " + to_string(i);
+    EXPECT_EQ_INT(PARSE_OK, reader.read(text + " ]", held));
+    Value& first = held[0];
+    copy = held;
+    first = 9.0;
+    EXPECT_EQ_DOUBLE(0.0, copy.numberAt(0));
+    EXPECT_EQ_DOUBLE(9.0, held.numberAt(0));
+
+    // a copy that handed out nothing still shares
+    Value plain;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"s\" : \"a string long enough to live on the heap\" }", plain));
+    size_t allocations = allocation_count;
+    Value shared = plain;
+    EXPECT_EQ_SIZE_T(allocations, allocation_count);
+    EXPECT_EQ_INT(true, (shared == plain));
+}
+
+static void test_parallel_write() {
+    Value root, array, object;
+    array = vector<Value>();
+    for (int i = 0; i < 10000; i++) {
+        Value element;
+        element["id"] = (double)i;
+        element["name"] = "item" + to_string(i);
+        array.append(element);
+        object["key" + to_string(i)] = (double)i;
+    }
+    root["array"] = array;
+    root["object"] = object;
+
+    FastWriter sequential, parallel;
+    parallel.enableParallel(4, 100);
+    EXPECT_EQ_STRING(sequential.write(root), parallel.write(root));
+    EXPECT_EQ_STRING(sequential.write(array), parallel.write(array));
+
+    Value small;
+    small = vector<Value>();
+    small.append(Value(1.0));
+    EXPECT_EQ_STRING("[ 1 ]", parallel.write(small));
+}
+
+#define TEST_PARALLEL(json_source) \
+    do {\
+        Reader reader;\
+        Value sequential, parallel;\
+        int ret = reader.read(json_source, sequential);\
+        EXPECT_EQ_INT(ret, reader.readParallel(json_source, parallel, 4, 1));\
+        EXPECT_EQ_INT(true, (sequential == parallel));\
+    } while (0)
+
+static void test_parallel_parse() {
+    string array_source = "[ ";
+    string object_source = "{ ";
+    for (int i = 0; i < 1000; i++) {
+        if (i != 0) {
+            array_source += ",\n";
+            object_source += ",\n";
+        }
+        array_source += "{ \"id\" : " + to_string(i) + ", \"s\" : \"a,]\\\"}\", \"a\" : [ 1, [ 2 ] ] }";
+        object_source += "\"k" + to_string(i % 900) + "\" : " + to_string(i);
+    }
+    array_source += " ]";
+    object_source += " }";
+    TEST_PARALLEL(array_source);
+    TEST_PARALLEL(object_source);
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.readParallel(array_source, value, 4, 1));
+    EXPECT_EQ_SIZE_T(1000, value.size());
+    EXPECT_EQ_STRING("a,]\"}", value[999]["s"].asString());
+
+    // the static entry points need no Reader object
+    Value sequential;
+    EXPECT_EQ_INT(PARSE_OK, Reader::parse(array_source, sequential));
+    EXPECT_EQ_INT(PARSE_OK, Reader::parseParallel(array_source, value, 4, 1));
+    EXPECT_EQ_INT(true, (sequential == value));
+
+    // a root array of numbers comes out packed, as the sequential parser stores it
+    std::string numbers = "[ 0";
+    for (int i = 1; i < 1000; i++)
+        numbers += i % 50 == 0 ? ", " + to_string(i) + ".5" : ", " + to_string(i);
+    numbers += " ]";
+    Value packed;
+    EXPECT_EQ_INT(PARSE_OK, Reader::parse(numbers, packed));
+    EXPECT_EQ_INT(PARSE_OK, reader.readParallel(numbers, value, 4, 1));
+    EXPECT_EQ_INT(true, packed.isPacked());
+    EXPECT_EQ_INT(true, value.isPacked());
+    EXPECT_EQ_SIZE_T(1000, value.size());
+    EXPECT_EQ_DOUBLE(950.5, value.numberAt(950));
+    EXPECT_EQ_INT(true, (packed == value));
+    EXPECT_EQ_INT(PARSE_OK, reader.readParallel("[ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 ]", value, 4, 1));
+    EXPECT_EQ_INT(true, value.isPacked());
+    EXPECT_EQ_INT(PARSE_OK, reader.readParallel("[ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, \"x\" ]", value, 4, 1));
+    EXPECT_EQ_INT(false, value.isPacked());
+    EXPECT_EQ_STRING("x", value[15].asString());
+
+    // the Reader's Features reach every partition and the sequential fallback
+    Features features;
+    features.lazyNumbers = true;
+    Reader lazy(features);
+    EXPECT_EQ_INT(PARSE_OK, lazy.readParallel(array_source, value, 4, 1));
+    EXPECT_EQ_INT(true, value[0]["id"].hasRawNumber());
+    EXPECT_EQ_STRING("999", value[999]["id"].getRawNumber());
+    EXPECT_EQ_INT(true, (sequential == value));
+    EXPECT_EQ_INT(PARSE_OK, lazy.readParallel("[ 1.50 ]", value, 4, 1));
+    EXPECT_EQ_STRING("1.50", value[0].getRawNumber());
+
+    TEST_PARALLEL("[ 1, 2, 3, tru, 5, [ 1 2 ] ]");
+    TEST_PARALLEL("[ 1, 2, 3, 4, 5, [ 1 2 ] ]");
+    TEST_PARALLEL("[ 1, 2, 3, 4, 5, ]");
+    TEST_PARALLEL("[ 1, 2, 3, 4, 5 }");
+    TEST_PARALLEL("[ 1, 2, 3, 4, 5 ] 6");
+    TEST_PARALLEL("[ 1, 2, 3, 4, \"5 ]");
+    TEST_PARALLEL("{ \"a\" : 1, \"b\" 2, \"c\" : 3 }");
+    TEST_PARALLEL("[ [ ], { }, \"\", 0 ]");
+    TEST_PARALLEL("\"scalar\"");
+}
+
+static void test_minify_prettify() {
+    string source = "{ \"z\" : [ 1 , 2,\n\t3 ], \"a\" : \"s p a c e \\\" [ ]\", \"m\" : { }, \"e\" : [ ],"
+                    "  \"long value with spaces\" : { \"k\" : null } }";
+    string result;
+    EXPECT_EQ_INT(PARSE_OK, minify(source, result));
+    EXPECT_EQ_STRING("{\"z\":[1,2,3],\"a\":\"s p a c e \\\" [ ]\",\"m\":{},\"e\":[],\"long value with spaces\":{\"k\":null}}", result);
+
+    string pretty;
+    EXPECT_EQ_INT(PARSE_OK, prettify(result, pretty, 2));
+    EXPECT_EQ_STRING("{\n  \"z\" : [\n    1,\n    2,\n    3\n  ],\n  \"a\" : \"s p a c e \\\" [ ]\",\n"
+                     "  \"m\" : {},\n  \"e\" : [],\n  \"long value with spaces\" : {\n    \"k\" : null\n  }\n}", pretty);
+
+    // with sorted keys the layout is the one of StyleWriter
+    Reader reader;
+    Value value;
+    string sorted = "{ \"a\" : [ 1, { \"b\" : true } ], \"c\" : \"d\" }";
+    EXPECT_EQ_INT(PARSE_OK, reader.read(sorted, value));
+    StyleWriter sw;
+    EXPECT_EQ_INT(PARSE_OK, prettify(sorted, pretty));
+    EXPECT_EQ_STRING(sw.write(value), pretty);
+
+    EXPECT_EQ_INT(PARSE_MISS_QUOTATION_MARK, minify("[ \"abc ]", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, minify("[ 1, 2 ", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, minify("[ 1, 2 }", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, prettify("{ \"a\" : 1 ]", result));
+    EXPECT_EQ_INT(PARSE_EXPECT_VALUE, minify(" \n ", result));
+
+    // values with nothing between them are not glued together, nothing may follow the root
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, minify("[1 2]", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, prettify("[1 2]", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, minify("[ \"a\" \"b\" ]", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, minify("[ [ 1 ] 2 ]", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, minify("{ \"a\" : 1 \"b\" : 2 }", result));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, prettify("{ \"a\" : { } \"b\" : 2 }", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, minify("tru e", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, prettify("tru e", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, minify("[1] [2]", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, prettify("[1][2]", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, minify("[1] x", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, minify("\"a\", 1", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, minify("1,2", result));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, prettify("{ } ,", result));
+    EXPECT_EQ_INT(PARSE_OK, minify(" -12.5e3 ", result));
+    EXPECT_EQ_STRING("-12.5e3", result);
+    EXPECT_EQ_INT(PARSE_OK, prettify("[1,\"x\",[]]", result));
+    EXPECT_EQ_STRING("[\n    1,\n    \"x\",\n    []\n]", result);
+}
+
+#define TEST_UTF8_ERROR(offset, json_source) \
+    do {\
+        Features features;\
+        features.validateUtf8 = true;\
+        Reader reader(features);\
+        Value value;\
+        EXPECT_EQ_INT(PARSE_INVALID_UTF8, reader.read(json_source, value));\
+        EXPECT_EQ_SIZE_T(offset, reader.getErrorOffset());\
+    } while (0)
+
+static void test_validate_utf8() {
+    Features features;
+    features.validateUtf8 = true;
+    Reader reader(features);
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("\"\xC2\xA2 \xE2\x82\xAC \xF0\x9D\x84\x9E\"", value));
+    EXPECT_EQ_STRING("\xC2\xA2 \xE2\x82\xAC \xF0\x9D\x84\x9E", value.asString());
+
+    TEST_UTF8_ERROR(3, "\"ab\x80\"");                 /* lone continuation byte */
+    TEST_UTF8_ERROR(1, "\"\xC0\xAF\"");                /* overlong '/' */
+    TEST_UTF8_ERROR(1, "\"\xE0\x80\xAF\"");            /* overlong 3 bytes */
+    TEST_UTF8_ERROR(1, "\"\xED\xA0\x80\"");            /* surrogate U+D800 */
+    TEST_UTF8_ERROR(1, "\"\xF4\x90\x80\x80\"");        /* above U+10FFFF */
+    TEST_UTF8_ERROR(2, "\"a\xE2\x82\"");               /* truncated */
+    TEST_UTF8_ERROR(1, "\"\xFF\"");
+
+    // the invalid byte sits behind a long ASCII run and in the middle of a block
+    string source = "[ \"" + string(100, 'a') + "\xC3\xA9" + string(70, 'b') + "\xC3\x28\" ]";
+    TEST_UTF8_ERROR(175, source);
+    EXPECT_EQ_INT(PARSE_INVALID_UTF8, reader.readParallel(source, value, 2, 1));
+    EXPECT_EQ_SIZE_T(175, reader.getErrorOffset());
+
+    // without the feature the bytes are copied as they are
+    Reader plain;
+    EXPECT_EQ_INT(PARSE_OK, plain.read("\"\xC0\xAF\"", value));
+    EXPECT_EQ_INT(PARSE_ROOT_NOT_SINGULAR, plain.read("[ 1 ] x", value));
+    EXPECT_EQ_SIZE_T(6, plain.getErrorOffset());
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, plain.readParallel("[ 1, 2, 3, tru ]", value, 2, 1));
+    EXPECT_EQ_SIZE_T(11, plain.getErrorOffset());
+}
+
+static void test_accessor() {
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a_rather_long_member_name\" : 1, \"b\" : [ 1, 2, 3 ], "
+                                         "\"another_long_member_name\" : \"x\" }", value));
+    const Value& root = value;
+
+    size_t before = allocation_count;
+    const Value* found = root.find("a_rather_long_member_name");
+    bool member = root.isMember("another_long_member_name") && !root.isMember("missing_long_member_name");
+    double sum = 0;
+    for (auto& e : root["b"])
+        sum += e.asDouble();
+    size_t names = 0;
+    for (auto mt = root.begin(); mt != root.end(); ++mt)
+        names += mt.name().size();
+    const Value& missing = root["missing_long_member_name"];
+    EXPECT_EQ_SIZE_T(before, allocation_count);
+
+    EXPECT_EQ_INT(true, (found != nullptr));
+    EXPECT_EQ_DOUBLE(1.0, found->asDouble());
+    EXPECT_EQ_INT(true, member);
+    EXPECT_EQ_DOUBLE(6.0, sum);
+    EXPECT_EQ_SIZE_T(50, names);
+    EXPECT_EQ_INT(JSON_NULL, missing.get_type());
+    EXPECT_EQ_INT(true, (root.find("missing") == nullptr));
+    EXPECT_EQ_STRING("x", root.get("another_long_member_name", Value("d")).asString());
+    EXPECT_EQ_STRING("d", root.get("missing", Value("d")).asString());
+
+    Value copy = value;
+    for (auto& e : copy["b"])
+        e = e.asDouble() * 2;
+    *copy.find("a_rather_long_member_name") = 5.0;
+    EXPECT_EQ_DOUBLE(6.0, copy["b"][2].asDouble());
+    EXPECT_EQ_DOUBLE(3.0, value["b"][2].asDouble());
+    EXPECT_EQ_DOUBLE(5.0, copy["a_rather_long_member_name"].asDouble());
+    EXPECT_EQ_DOUBLE(1.0, value["a_rather_long_member_name"].asDouble());
+    copy.removeMember("b");
+    EXPECT_EQ_SIZE_T(2, copy.size());
+    EXPECT_EQ_INT(true, (Value().begin() == Value().end()));
+#if __cplusplus >= 201703L
+    std::string_view key("b");
+    EXPECT_EQ_SIZE_T(3, value[key].size());
+    EXPECT_EQ_INT(true, value.isMember(key));
+#endif
+}
+
+// a new empty file, test binaries running side by side never share one
+static std::string temp_file() {
+#ifdef JSON_HAS_POSIX
+    char path[] = "/tmp/json_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return std::string();
+    close(fd);
+    return path;
+#else
+    char path[L_tmpnam];
+    return tmpnam(path) != nullptr ? path : "";
+#endif
+}
+
+static void test_gzip_ndjson() {
+    std::string ndjson;
+    for (int i = 1; i <= 200; i++)
+        ndjson += "{ \"id\" : " + std::to_string(i) + ", \"name\" : \"record " + std::to_string(i) + "\" }\n";
+    ndjson += "\n";
+
+    Value value;
+    size_t count = 0;
+    double sum = 0;
+    StringSource text(ndjson, 7);
+    NdjsonReader lines(text);
+    while (lines.next(value)) {
+        count++;
+        sum += value["id"].asDouble();
+    }
+    EXPECT_EQ_INT(PARSE_OK, lines.getError());
+    EXPECT_EQ_SIZE_T(200, count);
+    EXPECT_EQ_DOUBLE(20100.0, sum);
+
+    StringSource bad("[ 1 ]\n[ 2 ]\n[ 3, ]\n[ 4 ]", 5);
+    NdjsonReader bad_lines(bad);
+    count = 0;
+    while (bad_lines.next(value))
+        count++;
+    EXPECT_EQ_SIZE_T(2, count);
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, bad_lines.getError());
+    EXPECT_EQ_SIZE_T(3, bad_lines.getLine());
+
+#ifdef JSON_USE_ZLIB
+    std::string temp = temp_file();
+    const char* path = temp.c_str();
+    gzFile out = temp.empty() ? nullptr : gzopen(path, "wb");
+    EXPECT_EQ_INT(true, (out != nullptr));
+    if (out == nullptr)
+        return;
+    gzwrite(out, ndjson.data(), static_cast<unsigned>(ndjson.size()));
+    gzclose(out);
+
+    GzipSource gzip(path, 64, 2);
+    NdjsonReader records(gzip);
+    count = 0;
+    sum = 0;
+    while (records.next(value)) {
+        count++;
+        sum += value["id"].asDouble();
+    }
+    EXPECT_EQ_INT(PARSE_OK, records.getError());
+    EXPECT_EQ_SIZE_T(200, count);
+    EXPECT_EQ_DOUBLE(20100.0, sum);
+    EXPECT_EQ_STRING("record 200", value["name"].asString());
+
+    // a compressed root array is read one element at a time
+    out = gzopen(path, "wb");
+    std::string document = "[ { \"a\" : [ 1, 2, 3 ] }, \"" + std::string(500, 'x') + "\" ]";
+    gzwrite(out, document.data(), static_cast<unsigned>(document.size()));
+    gzclose(out);
+    GzipSource whole(path, 64, 2);
+    ArrayReader elements(whole);
+    EXPECT_EQ_INT(true, elements.next(value));
+    EXPECT_EQ_SIZE_T(3, value["a"].size());
+    EXPECT_EQ_INT(true, elements.next(value));
+    EXPECT_EQ_SIZE_T(500, value.asString().size());
+    EXPECT_EQ_INT(false, elements.next(value));
+    EXPECT_EQ_INT(PARSE_OK, elements.getError());
+
+    GzipSource missing((temp + ".missing").c_str());
+    ArrayReader missing_elements(missing);
+    EXPECT_EQ_INT(false, missing_elements.next(value));
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, missing_elements.getError());
+
+    GzipSource abandoned(path, 16, 2);
+    std::string chunk;
+    EXPECT_EQ_INT(true, abandoned.read(chunk));
+    remove(path);
+#endif
+}
+
+#define TEST_SCHEMA_ERROR(path, json)\
+    do {\
+        Reader reader;\
+        Value value;\
+        EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read(json, value, schema));\
+        EXPECT_EQ_STRING(path, reader.getErrorPath());\
+    } while(0)
+
+static void test_schema() {
+    Schema schema;
+    EXPECT_EQ_INT(PARSE_OK, schema.compile(
+        "{ \"type\" : \"object\", \"required\" : [ \"id\", \"items\" ], \"additionalProperties\" : false,"
+        "  \"properties\" : {"
+        "    \"id\" : { \"type\" : \"integer\", \"minimum\" : 1 },"
+        "    \"state\" : { \"enum\" : [ \"open\", \"closed\" ] },"
+        "    \"note\" : { \"type\" : [ \"string\", \"null\" ], \"maxLength\" : 4 },"
+        "    \"items\" : { \"type\" : \"array\", \"maxItems\" : 3, \"items\" : {"
+        "      \"type\" : \"object\", \"required\" : [ \"price\" ],"
+        "      \"properties\" : { \"price\" : { \"type\" : \"number\", \"exclusiveMinimum\" : 0 } } } } } }"));
+
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"id\" : 7, \"state\" : \"open\", \"note\" : \"\\u00e9t\\u00e9\", "
+                                         "\"items\" : [ { \"price\" : 1.5, \"sku\" : \"a\" }, {\"price\" : 2} ] }", value, schema));
+    EXPECT_EQ_DOUBLE(2.0, value["items"][1]["price"].asDouble());
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"id\" : 1, \"note\" : null, \"items\" : [] }", value, schema));
+
+    TEST_SCHEMA_ERROR("", "[ 1 ]");
+    TEST_SCHEMA_ERROR("/id", "{ \"id\" : 1.5, \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/id", "{ \"id\" : 0, \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/items", "{ \"id\" : 1 }");
+    TEST_SCHEMA_ERROR("/state", "{ \"id\" : 1, \"state\" : \"lost\", \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/note", "{ \"id\" : 1, \"note\" : \"12345\", \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/note", "{ \"id\" : 1, \"note\" : 5, \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/a~1b", "{ \"id\" : 1, \"a/b\" : 5, \"items\" : [] }");
+    TEST_SCHEMA_ERROR("/items", "{ \"id\" : 1, \"items\" : [ {\"price\" : 1}, {\"price\" : 1}, {\"price\" : 1}, {\"price\" : 1} ] }");
+    TEST_SCHEMA_ERROR("/items/1/price", "{ \"id\" : 1, \"items\" : [ { \"price\" : 1 }, { \"price\" : 0 } ] }");
+    TEST_SCHEMA_ERROR("/items/0/price", "{ \"id\" : 1, \"items\" : [ { } ] }");
+
+    // a wrong type is rejected from its first byte, the rest is never parsed
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("{ \"id\" : 1, \"items\" : { \"broken\" ", value, schema));
+    EXPECT_EQ_SIZE_T(22, reader.getErrorOffset());
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, reader.read("{ \"id\" : -, \"items\" : [] }", value, schema));
+
+    // inclusive and exclusive bounds on one number are both checked, in either order
+    Schema range;
+    EXPECT_EQ_INT(PARSE_OK, range.compile("{ \"minimum\" : 0, \"exclusiveMinimum\" : 5, \"exclusiveMaximum\" : 10, \"maximum\" : 8 }"));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("6", value, range));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("8", value, range));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("5", value, range));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("9", value, range));
+    EXPECT_EQ_INT(PARSE_OK, range.compile("{ \"exclusiveMinimum\" : 0, \"minimum\" : 5, \"maximum\" : 10, \"exclusiveMaximum\" : 8 }"));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("5", value, range));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("4", value, range));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("8", value, range));
+    EXPECT_EQ_INT(PARSE_INVALID_SCHEMA, range.compile("{ \"exclusiveMaximum\" : true }"));
+
+    Schema any;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[ 1 ]", value, any));
+    EXPECT_EQ_INT(PARSE_OK, any.compile("{ \"items\" : false }"));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[]", value, any));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("[ null ]", value, any));
+    EXPECT_EQ_STRING("/0", reader.getErrorPath());
+    EXPECT_EQ_INT(PARSE_INVALID_SCHEMA, any.compile("{ \"type\" : \"decimal\" }"));
+    EXPECT_EQ_INT(PARSE_INVALID_SCHEMA, any.compile("{ \"maxLength\" : -1 }"));
+    EXPECT_EQ_INT(PARSE_MISS_COLON, any.compile("{ \"type\" }"));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : {} }", value));
+    EXPECT_EQ_SIZE_T(0, value["a"].size());
+}
+
+static void test_reuse_storage() {
+    Features features;
+    features.reuseStorage = true;
+    Reader reader(features);
+    Value value;
+    std::string first = "{ \"id\" : 1, \"name\" : \"a fairly long first name\", \"tags\" : [ \"red\", \"green\" ], "
+                        "\"owner\" : { \"login\" : \"someone\", \"admin\" : false }, \"score\" : null }";
+    std::string second = "{ \"score\" : 2.5, \"id\" : 2, \"tags\" : [ \"blue\", \"cyan\" ], \"name\" : \"second name\", "
+                         "\"owner\" : { \"admin\" : true, \"login\" : \"another\" } }";
+    EXPECT_EQ_INT(PARSE_OK, reader.read(first, value));
+    EXPECT_EQ_INT(PARSE_OK, reader.read(second, value));
+
+    // same shape after warm up, nothing is allocated
+    size_t before = allocation_count;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(first, value));
+    EXPECT_EQ_INT(PARSE_OK, reader.read(second, value));
+    EXPECT_EQ_SIZE_T(before, allocation_count);
+
+    EXPECT_EQ_DOUBLE(2.0, value["id"].asDouble());
+    EXPECT_EQ_STRING("second name", value["name"].asString());
+    EXPECT_EQ_STRING("cyan", value["tags"][1].asString());
+    EXPECT_EQ_INT(JSON_TRUE, value["owner"]["admin"].get_type());
+    EXPECT_EQ_DOUBLE(2.5, value["score"].asDouble());
+
+    // members, elements and types that went away are dropped
+    Value plain;
+    Reader().read("{ \"id\" : 3, \"tags\" : [ 1 ], \"owner\" : \"nobody\" }", plain);
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"id\" : 3, \"tags\" : [ 1 ], \"owner\" : \"nobody\" }", value));
+    EXPECT_EQ_INT(true, (value == plain));
+    EXPECT_EQ_SIZE_T(3, value.size());
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : 1, \"a\" : 2, \"b\" : 3 }", value));
+    EXPECT_EQ_SIZE_T(2, value.size());
+
+    // a shared Value is never written through
+    Value copy = value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : 5, \"b\" : 6 }", value));
+    EXPECT_EQ_DOUBLE(2.0, copy["a"].asDouble());
+    EXPECT_EQ_DOUBLE(5.0, value["a"].asDouble());
+
+    // Readers on different threads keep their scratch to themselves
+    std::atomic<int> wrong{ 0 };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&, i] {
+            Reader own(features);
+            Value record;
+            const std::string& text = i % 2 == 0 ? first : second;
+            for (int n = 0; n < 200; n++) {
+                if (own.read(text, record) != PARSE_OK || record["id"].asDouble() != (i % 2 == 0 ? 1.0 : 2.0))
+                    wrong++;
+                if (Reader::parse(text, record) != PARSE_OK || record.size() != 5)
+                    wrong++;
+            }
+        });
+    }
+    for (auto& e : threads)
+        e.join();
+    EXPECT_EQ_INT(0, wrong.load());
+}
+
+static void test_stream_writer() {
+    std::string out;
+    {
+        StreamWriter writer(out);
+        writer.startObject();
+        writer.key("id");
+        writer.intValue(9007199254740993LL);
+        writer.key("name");
+        writer.stringValue("a \"quoted\"\n name");
+        writer.key("rows");
+        writer.startArray();
+        writer.startArray();
+        writer.endArray();
+        writer.doubleValue(0.5);
+        writer.boolValue(true);
+        writer.nullValue();
+        writer.startObject();
+        writer.endObject();
+        writer.endArray();
+        writer.endObject();
+    }
+    EXPECT_EQ_STRING("{\"id\":9007199254740993,\"name\":\"a \\\"quoted\\\"\\n name\",\"rows\":[[],0.5,true,null,{}]}", out);
+
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : [ 1, \"x\", { \"b\" : null } ], \"c\" : false }", value));
+    out.clear();
+    {
+        StreamWriter writer(out);
+        writer.value(value);
+    }
+    std::string minified;
+    minify(FastWriter().write(value), minified);
+    EXPECT_EQ_STRING(minified, out);
+
+#ifdef JSON_HAS_POSIX
+    // rows go out through a small buffer, memory does not grow with the row count
+    FILE* file = tmpfile();
+    EXPECT_EQ_INT(true, (file != nullptr));
+    if (file == nullptr)
+        return;
+    {
+        StreamWriter writer(fileno(file), 64);
+        writer.startArray();
+        for (int i = 0; i < 1000; i++) {
+            writer.startObject();
+            writer.key("row");
+            writer.intValue(i);
+            writer.endObject();
+        }
+        writer.endArray();
+        EXPECT_EQ_INT(true, writer.flush());
+    }
+    std::string written;
+    char buf[4096];
+    rewind(file);
+    size_t length;
+    while ((length = fread(buf, 1, sizeof(buf), file)) > 0)
+        written.append(buf, length);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_OK, reader.read(written, value));
+    EXPECT_EQ_SIZE_T(1000, value.size());
+    EXPECT_EQ_DOUBLE(999.0, value[999]["row"].asDouble());
+#endif
+}
+
+static void test_frozen_document() {
+    DocumentPublisher publisher(8);
+    {
+        DocumentPublisher::Session session(publisher);
+        EXPECT_EQ_INT(true, (session.read().get() == nullptr));
+    }
+
+    Value config;
+    config["version"] = 0.0;
+    config["copy"] = 0.0;
+    publisher.publish(config);
+
+    // a reader holding a version keeps it alive across publishes
+    {
+        DocumentPublisher::Session session(publisher);
+        DocumentPublisher::View view = session.read();
+        config["version"] = 1.0;
+        config["copy"] = 1.0;
+        publisher.publish(config);
+        EXPECT_EQ_SIZE_T(1, publisher.retiredCount());
+        EXPECT_EQ_DOUBLE(0.0, (*view)["version"].asDouble());
+        EXPECT_EQ_DOUBLE(1.0, (*session.read())["version"].asDouble());
+    }
+    publisher.reclaim();
+    EXPECT_EQ_SIZE_T(0, publisher.retiredCount());
+
+    // more sessions than max_readers get slots of their own, a reader in a
+    // later block still holds back its version
+    {
+        std::vector<std::unique_ptr<DocumentPublisher::Session>> sessions;
+        for (int i = 0; i < 200; i++)
+            sessions.emplace_back(new DocumentPublisher::Session(publisher));
+        DocumentPublisher::View last = sessions.back()->read();
+        config["version"] = 2.0;
+        config["copy"] = 2.0;
+        publisher.publish(config);
+        EXPECT_EQ_SIZE_T(1, publisher.retiredCount());
+        EXPECT_EQ_DOUBLE(1.0, (*last)["version"].asDouble());
+        EXPECT_EQ_DOUBLE(2.0, (*sessions.front()->read())["version"].asDouble());
+    }
+    publisher.reclaim();
+    EXPECT_EQ_SIZE_T(0, publisher.retiredCount());
+
+    // readers see whole versions while the writer keeps swapping them
+    std::atomic<bool> stop{ false };
+    std::atomic<int> torn{ 0 };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&] {
+            DocumentPublisher::Session session(publisher);
+            double last = 0;
+            while (!stop.load()) {
+                DocumentPublisher::View view = session.read();
+                double version = view->find("version")->asDouble();
+                if (version != (*view)["copy"].asDouble() || version < last)
+                    torn++;
+                last = version;
+            }
+        });
+    }
+    for (int i = 1; i <= 200; i++) {
+        config["version"] = static_cast<double>(i);
+        config["copy"] = static_cast<double>(i);
+        publisher.publish(config);
+    }
+    stop = true;
+    for (auto& e : readers)
+        e.join();
+    EXPECT_EQ_INT(0, torn.load());
+    publisher.reclaim();
+    EXPECT_EQ_SIZE_T(0, publisher.retiredCount());
+
+    FrozenDocument frozen(config);
+    EXPECT_EQ_INT(true, (frozen->hash() == config.hash()));
+    EXPECT_EQ_DOUBLE(200.0, (*frozen)["version"].asDouble());
+}
+
+static void test_shape_cache() {
+    const char* records[] = {
+        "{ \"id\" : 1, \"kind\" : \"click\", \"at\" : { \"x\" : 1, \"y\" : 2 } }",
+        "{ \"id\" : 2, \"kind\" : \"click\", \"at\" : { \"x\" : 3, \"y\" : 4 } }",
+        "{ \"id\" : 3, \"kind\" : \"view\", \"at\" : { \"x\" : 5, \"y\" : 6 } }",
+        "{ \"id\" : 4, \"kind\" : \"view\" }",
+        "{ \"id\" : 5, \"kind\" : \"view\", \"at\" : { \"x\" : 7, \"y\" : 8, \"z\" : 9 }, \"extra\" : true }",
+        "{ \"id\" : 6, \"at\" : null, \"kind\" : \"moved\" }",
+        "{ \"id\" : 7, \"kind\" : \"dup\", \"kind\" : \"second\", \"at\" : [] }",
+        "{ \"id\" : 8, \"ki\\u006ed\" : \"escaped\", \"at\" : {} }",
+        "{\"id\":9,\"kind\":\"tight\",\"at\":{\"x\":1,\"y\":2}}",
+        "{ \"id\" : 10, \"kind\" : \"click\", \"at\" : { \"x\" : 11, \"y\" : 12 } }",
+        "{ \"id\" : 11, \"kind\" : \"click\", \"at\" : { \"x\" : 13, \"y\" : 14 } }",
+        "{ \"id\" : 12, \"kind\" : \"click\" , \"at\" : { \"x\" : 1, \"y\" : tru } }",
+        "{ \"id\" : 13, \"kind\" : \"click\", \"at\" : { \"x\" : 15, \"y\" : 16 } }"
+    };
+    std::string ndjson;
+    for (auto e : records)
+        ndjson += std::string(e) + "\n";
+
+    // one long lived parser learns the layouts, a fresh one per record never hits
+    StringSource source(ndjson, 32);
+    NdjsonReader lines(source);
+    Value cached;
+    for (auto e : records) {
+        StringSource single(e);
+        NdjsonReader fresh(single);
+        Value expect;
+        bool valid = fresh.next(expect);
+        EXPECT_EQ_INT(valid, lines.next(cached));
+        if (!valid) {
+            EXPECT_EQ_INT(fresh.getError(), lines.getError());
+            break;
+        }
+        EXPECT_EQ_INT(true, (expect == cached));
+    }
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, lines.getError());
+    EXPECT_EQ_SIZE_T(12, lines.getLine());
+
+    // the same object layout at several depths
+    Reader reader;
+    Value value;
+    std::string nested = "[ ";
+    for (int i = 0; i < 50; i++)
+        nested += "{ \"b\" : " + std::to_string(i) + ", \"a\" : { \"b\" : 0, \"a\" : null } }, ";
+    nested += "{ \"b\" : 50, \"a\" : { \"b\" : 0, \"c\" : 1 } } ]";
+    EXPECT_EQ_INT(PARSE_OK, reader.read(nested, value));
+    EXPECT_EQ_SIZE_T(51, value.size());
+    EXPECT_EQ_DOUBLE(49.0, value[49]["b"].asDouble());
+    EXPECT_EQ_INT(JSON_NULL, value[49]["a"]["a"].get_type());
+    EXPECT_EQ_DOUBLE(1.0, value[50]["a"]["c"].asDouble());
+    EXPECT_EQ_INT(false, value[50]["a"].isMember("a"));
+}
+
+static void test_offset_index() {
+#ifdef JSON_HAS_POSIX
+    std::string json_temp = temp_file(), index_temp = temp_file();
+    const char* json_path = json_temp.c_str();
+    const char* index_path = index_temp.c_str();
+    std::string document = "[\n";
+    for (int i = 0; i < 1000; i++)
+        document += "  { \"id\" : " + std::to_string(i) + ", \"tags\" : [ \"a\", \"b,]\" ] },\n";
+    document += "  [ 1, 2 ], \"last\"\n]\n";
+    FILE* file = json_temp.empty() || index_temp.empty() ? nullptr : fopen(json_path, "wb");
+    EXPECT_EQ_INT(true, (file != nullptr));
+    if (file == nullptr)
+        return;
+    fwrite(document.data(), 1, document.size(), file);
+    fclose(file);
+
+    Reader reader;
+    Value whole;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(document, whole));
+    OffsetIndex index;
+    int ret = OffsetIndex::build(json_path, index_path);
+    EXPECT_EQ_INT(PARSE_OK, ret);
+    if (ret == PARSE_OK) {
+        ret = index.open(json_path, index_path);
+        EXPECT_EQ_INT(PARSE_OK, ret);
+    }
+    EXPECT_EQ_SIZE_T(1002, index.size());
+    if (ret != PARSE_OK || index.size() != 1002) {
+        remove(json_path);
+        remove(index_path);
+        return;
+    }
+
+    Value element;
+    size_t picks[] = { 0, 999, 500, 1000, 1001, 7 };
+    for (auto n : picks) {
+        EXPECT_EQ_INT(PARSE_OK, reader.read(index, n, element));
+        EXPECT_EQ_INT(true, (element == whole[n]));
+    }
+    Value range;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(index, 10, 5, range));
+    EXPECT_EQ_SIZE_T(5, range.size());
+    EXPECT_EQ_DOUBLE(14.0, range[4]["id"].asDouble());
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, reader.read(index, 1002, element));
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, reader.read(index, 1000, 3, range));
+
+    // depth 3 indexes the values of every tags array
+    EXPECT_EQ_INT(PARSE_OK, OffsetIndex::build(json_path, index_path, 3));
+    EXPECT_EQ_INT(PARSE_OK, index.open(json_path, index_path));
+    EXPECT_EQ_SIZE_T(2000, index.size());
+    EXPECT_EQ_INT(PARSE_OK, reader.read(index, 1999, element));
+    EXPECT_EQ_STRING("b,]", element.asString());
+
+    // an index whose header is damaged is refused
+    std::string saved;
+    file = fopen(index_path, "rb");
+    char buf[4096];
+    size_t length;
+    while ((length = fread(buf, 1, sizeof(buf), file)) > 0)
+        saved.append(buf, length);
+    fclose(file);
+    std::string damaged = saved;
+    damaged[8] = '\0';
+    file = fopen(index_path, "wb");
+    fwrite(damaged.data(), 1, damaged.size(), file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, index.open(json_path, index_path));
+    damaged = saved;
+    damaged[23] = '\x80';
+    file = fopen(index_path, "wb");
+    fwrite(damaged.data(), 1, damaged.size(), file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, index.open(json_path, index_path));
+    EXPECT_EQ_SIZE_T(0, index.size());
+    file = fopen(index_path, "wb");
+    fwrite(saved.data(), 1, saved.size(), file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_OK, index.open(json_path, index_path));
+
+    // an index of another version of the file is refused
+    file = fopen(json_path, "ab");
+    fputs(" ", file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, index.open(json_path, index_path));
+    EXPECT_EQ_SIZE_T(0, index.size());
+
+    file = fopen(json_path, "wb");
+    fputs("[ 1, 2, tru ]", file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_OK, OffsetIndex::build(json_path, index_path));
+    EXPECT_EQ_INT(PARSE_OK, index.open(json_path, index_path));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, reader.read(index, 2, element));
+    EXPECT_EQ_SIZE_T(8, reader.getErrorOffset());
+    // a failed build leaves the previous index in place
+    index.close();
+    file = fopen(json_path, "wb");
+    fputs("[ 1, 2, [ 3 ]", file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, OffsetIndex::build(json_path, index_path));
+    EXPECT_EQ_INT(PARSE_INPUT_ERROR, OffsetIndex::build(json_temp + ".missing", index_path));
+    file = fopen(json_path, "wb");
+    fputs("[ 1, 2, tru ]", file);
+    fclose(file);
+    EXPECT_EQ_INT(PARSE_OK, index.open(json_path, index_path));
+    EXPECT_EQ_SIZE_T(3, index.size());
+    index.close();
+    remove(json_path);
+    remove(index_path);
+#endif
+}
+
+static void test_columns() {
+    ColumnReader reader;
+    EXPECT_EQ_SIZE_T(0, reader.addColumn("/id", COLUMN_INT64));
+    reader.addColumn("/price", COLUMN_DOUBLE);
+    reader.addColumn("/user/name", COLUMN_STRING);
+    reader.addColumn("/user/admin", COLUMN_BOOL);
+    reader.addColumn("/a~1b", COLUMN_INT64);
+    EXPECT_EQ_INT(PARSE_OK, reader.parseArray(
+        "[ { \"id\" : 9007199254740993, \"price\" : 1.5, \"user\" : { \"name\" : \"ann\", \"admin\" : true }, \"skip\" : [ { \"id\" : 0 } ] },"
+        "  { \"price\" : null, \"user\" : { \"name\" : \"b\\u00e9\" }, \"a/b\" : 7 },"
+        "  { \"id\" : 3, \"id\" : 4, \"user\" : null, \"extra\" : { \"user\" : { \"name\" : \"no\" } } }, {} ]"));
+    EXPECT_EQ_SIZE_T(4, reader.rows());
+
+    const Column& id = reader.column(0);
+    EXPECT_EQ_INT(true, (id.asInt(0) == 9007199254740993LL));
+    EXPECT_EQ_INT(true, id.isNull(1));
+    EXPECT_EQ_INT(true, (id.asInt(2) == 3));
+    EXPECT_EQ_INT(true, id.isNull(3));
+    EXPECT_EQ_DOUBLE(1.5, reader.column(1).asDouble(0));
+    EXPECT_EQ_INT(true, reader.column(1).isNull(1));
+    const Column& name = reader.column(2);
+    EXPECT_EQ_STRING("ann", name.asString(0));
+    EXPECT_EQ_STRING("b\xC3\xA9", name.asString(1));
+    EXPECT_EQ_INT(true, name.isNull(2));
+    EXPECT_EQ_STRING("annb\xC3\xA9", name.chars());
+    EXPECT_EQ_SIZE_T(5, name.offsets().size());
+    EXPECT_EQ_INT(true, reader.column(3).asBool(0));
+    EXPECT_EQ_INT(true, reader.column(3).isNull(1));
+    EXPECT_EQ_INT(true, (reader.column(4).asInt(1) == 7));
+    EXPECT_EQ_INT(0x1, (reader.column(1).validityBitmap()[0]));
+
+    // a record that fails adds no row, the earlier ones stay
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.parseArray("[ { \"id\" : 5, \"user\" : { \"name\" : \"c\" } }, { \"id\" : 6, \"user\" : { \"name\" : 1 } } ]"));
+    EXPECT_EQ_SIZE_T(5, reader.rows());
+    EXPECT_EQ_SIZE_T(5, reader.column(2).size());
+    EXPECT_EQ_STRING("annb\xC3\xA9" "c", reader.column(2).chars());
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.parseArray("[ { \"id\" : 1.5 } ]"));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, reader.parseArray("[ 1 ]"));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, reader.parseArray("[ {} {} ]"));
+    EXPECT_EQ_SIZE_T(6, reader.rows());
+
+    ColumnReader lines;
+    lines.addColumn("/n", COLUMN_DOUBLE);
+    lines.addColumn("/s", COLUMN_STRING);
+    std::string ndjson;
+    for (int i = 0; i < 100; i++)
+        ndjson += "{ \"n\" : " + std::to_string(i) + ", \"s\" : \"row " + std::to_string(i) + "\" }\n";
+    ndjson += "\n{ \"n\" : 100 }";
+    StringSource source(ndjson, 10);
+    EXPECT_EQ_INT(PARSE_OK, lines.parseNdjson(source));
+    EXPECT_EQ_SIZE_T(101, lines.rows());
+    double sum = 0;
+    for (auto e : lines.column(0).doubles())
+        sum += e;
+    EXPECT_EQ_DOUBLE(5050.0, sum);
+    EXPECT_EQ_STRING("row 99", lines.column(1).asString(99));
+    EXPECT_EQ_INT(true, lines.column(1).isNull(100));
+    StringSource bad("{ \"n\" : 1 }\n{ \"n\" : x }\n", 4);
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, lines.parseNdjson(bad));
+    EXPECT_EQ_SIZE_T(20, lines.getErrorOffset());
+    EXPECT_EQ_SIZE_T(102, lines.rows());
+}
+
+static void test_array_reader() {
+    std::string document = "[\n";
+    for (int i = 0; i < 500; i++)
+        document += "  { \"id\" : " + std::to_string(i) + ", \"text\" : \"brackets ] } , inside\" },\n";
+    document += "  [ 1, [ 2 ] ], \"tail\"\n]\n";
+
+    // 64 byte chunks, the buffer never holds much more than one element
+    StringSource source(document, 64);
+    ArrayReader elements(source);
+    Value element;
+    size_t count = 0;
+    double sum = 0;
+    size_t before = 0;
+    while (elements.next(element)) {
+        if (count < 500)
+            sum += element["id"].asDouble();
+        // same shape as the previous element, parsed over without allocating
+        if (count == 100)
+            before = allocation_count;
+        if (count == 199)
+            EXPECT_EQ_SIZE_T(before, allocation_count);
+        count++;
+    }
+    EXPECT_EQ_INT(PARSE_OK, elements.getError());
+    EXPECT_EQ_SIZE_T(502, count);
+    EXPECT_EQ_SIZE_T(502, elements.getIndex());
+    EXPECT_EQ_DOUBLE(124750.0, sum);
+    EXPECT_EQ_STRING("tail", element.asString());
+
+    StringSource empty(" [ ] ");
+    ArrayReader none(empty);
+    EXPECT_EQ_INT(false, none.next(element));
+    EXPECT_EQ_INT(PARSE_OK, none.getError());
+
+    StringSource bad("[ 1, 2, tru, 4 ]", 3);
+    ArrayReader broken(bad);
+    count = 0;
+    while (broken.next(element))
+        count++;
+    EXPECT_EQ_SIZE_T(2, count);
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, broken.getError());
+    EXPECT_EQ_SIZE_T(8, broken.getErrorOffset());
+
+    StringSource cut("[ 1, 2", 3);
+    ArrayReader truncated(cut);
+    while (truncated.next(element));
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, truncated.getError());
+    StringSource object("{ \"a\" : 1 }");
+    ArrayReader wrong(object);
+    EXPECT_EQ_INT(false, wrong.next(element));
+    EXPECT_EQ_INT(PARSE_TYPE_MISMATCH, wrong.getError());
+    StringSource nothing("  ");
+    ArrayReader blank(nothing);
+    EXPECT_EQ_INT(false, blank.next(element));
+    EXPECT_EQ_INT(PARSE_EXPECT_VALUE, blank.getError());
+}
+
+static void test_packed_numbers() {
+    std::string text = "[ 0.5";
+    for (int i = 1; i < 20; i++)
+        text += ", " + std::to_string(i * -3);
+    text += " ]";
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(text, value));
+    const Value& root = value;
+    EXPECT_EQ_INT(true, root.isPacked());
+    EXPECT_EQ_SIZE_T(20, root.size());
+    EXPECT_EQ_DOUBLE(0.5, root.packedNumbers()[0]);
+    EXPECT_EQ_DOUBLE(-9.0, root[3].asDouble());
+    double sum = 0;
+    for (auto& e : root)
+        sum += e.asDouble();
+    EXPECT_EQ_DOUBLE(-569.5, sum);
+
+    // the same array as ordinary elements writes, compares and hashes the same
+    Value::array_type elements;
+    for (auto e : root.packedNumbers())
+        elements.push_back(e);
+    Value plain;
+    plain = elements;
+    EXPECT_EQ_INT(false, plain.isPacked());
+    EXPECT_EQ_STRING(FastWriter().write(plain), FastWriter().write(value));
+    EXPECT_EQ_STRING(StyleWriter().write(plain), StyleWriter().write(value));
+    std::string streamed;
+    StreamWriter(streamed).value(value);
+    EXPECT_EQ_STRING("[0.5,-3,-6,-9,-12,-15,-18,-21,-24,-27,-30,-33,-36,-39,-42,-45,-48,-51,-54,-57]", streamed);
+    EXPECT_EQ_INT(true, (plain == value && value == plain));
+    EXPECT_EQ_SIZE_T(plain.hash(), value.hash());
+
+    // numberAt reads the doubles, a non-const operator[] read keeps them packed
+    EXPECT_EQ_DOUBLE(-57.0, value.numberAt(19));
+    EXPECT_EQ_DOUBLE(-6.0, value[2].asDouble());
+    EXPECT_EQ_INT(true, value.isPacked());
+    EXPECT_EQ_DOUBLE(-6.0, value.numberAt(2));
+    EXPECT_EQ_STRING(FastWriter().write(plain), FastWriter().write(value));
+
+    // a write goes to the copy it goes through, the original keeps its numbers
+    Value copy = value;
+    copy[1] = 7.0;
+    EXPECT_EQ_INT(true, copy.isPacked());
+    EXPECT_EQ_DOUBLE(7.0, copy[1].asDouble());
+    EXPECT_EQ_DOUBLE(7.0, copy.numberAt(1));
+    EXPECT_EQ_DOUBLE(7.0, copy.packedNumbers()[1]);
+    EXPECT_EQ_DOUBLE(-3.0, root[1].asDouble());
+    EXPECT_EQ_INT(true, (copy != value));
+    EXPECT_EQ_INT(true, (plain == value));
+    Value compacted = copy;
+    compacted.compact();
+    EXPECT_EQ_INT(true, (compacted == copy));
+    EXPECT_EQ_SIZE_T(copy.hash(), compacted.hash());
+
+    // a large exposed array is styled in one pass over its numbers, not one per element
+    std::vector<double> many(100000, 1.5);
+    Value large;
+    large.setNumbers(many);
+    large[0] = 5.0;
+    EXPECT_EQ_INT(true, large.isPacked());
+    std::string styled = StyleWriter().write(large);
+    Value styled_back;
+    EXPECT_EQ_INT(PARSE_OK, reader.read(styled, styled_back));
+    EXPECT_EQ_INT(true, (styled_back == large));
+    EXPECT_EQ_DOUBLE(5.0, styled_back[0].asDouble());
+
+    // anything but a number there makes it an ordinary array
+    copy[2] = "x";
+    EXPECT_EQ_INT(false, copy.isPacked());
+    EXPECT_EQ_STRING("x", copy[2].asString());
+    EXPECT_EQ_DOUBLE(7.0, copy.numberAt(1));
+    copy.compact();
+    EXPECT_EQ_INT(false, copy.isPacked());
+    EXPECT_EQ_STRING("x", copy[2].asString());
+    EXPECT_EQ_SIZE_T(20, copy.size());
+    copy.append(1.0);
+    EXPECT_EQ_SIZE_T(21, copy.size());
+    EXPECT_EQ_DOUBLE(7.0, copy[1].asDouble());
+
+    // short arrays and arrays with anything else are ordinary
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[ 1, 2, 3 ]", value));
+    EXPECT_EQ_INT(false, value.isPacked());
+    EXPECT_EQ_INT(PARSE_OK, reader.read(text.substr(0, text.size() - 1) + ", \"x\", [ 1 ] ]", value));
+    EXPECT_EQ_INT(false, value.isPacked());
+    EXPECT_EQ_SIZE_T(22, value.size());
+    EXPECT_EQ_DOUBLE(-57.0, value[19].asDouble());
+    EXPECT_EQ_STRING("x", value[20].asString());
+    EXPECT_EQ_INT(PARSE_MISS_COMMA_OR_SQUARE_BRAKET, reader.read("[ 1, 2 3 ]", value));
+    EXPECT_EQ_INT(PARSE_INVALID_VALUE, reader.read("[ 1, 2, -x ]", value));
+
+    // in reuse mode the buffer is refilled in place
+    Features features;
+    features.reuseStorage = true;
+    Reader reuse(features);
+    EXPECT_EQ_INT(PARSE_OK, reuse.read(text, value));
+    size_t before = allocation_count;
+    EXPECT_EQ_INT(PARSE_OK, reuse.read(text, value));
+    EXPECT_EQ_SIZE_T(before, allocation_count);
+    EXPECT_EQ_INT(true, (value == plain));
+}
+
+static void test_lazy_numbers() {
+    Features features;
+    features.lazyNumbers = true;
+    Reader reader(features);
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"a\" : 1.50, \"b\" : [ 9007199254740993, -0, 1E-400, 2e+3 ] }", value));
+    EXPECT_EQ_INT(true, value["a"].hasRawNumber());
+    EXPECT_EQ_STRING("1.50", value["a"].getRawNumber());
+    EXPECT_EQ_DOUBLE(1.5, value["a"].asDouble());
+    EXPECT_EQ_DOUBLE(2000.0, value["b"][3].asDouble());
+    EXPECT_EQ_DOUBLE(0.0, value["b"][2].asDouble());
+    EXPECT_EQ_INT(true, (value["b"][0].asInt() == 9007199254740993LL));
+    EXPECT_EQ_INT(true, (value["b"][3].asInt() == 2000));
+
+    // writers copy the text unchanged
+    EXPECT_EQ_STRING("{ \"a\" : 1.50 , \"b\" : [ 9007199254740993 , -0 , 1E-400 , 2e+3 ] }", FastWriter().write(value));
+    std::string streamed;
+    StreamWriter(streamed).value(value);
+    EXPECT_EQ_STRING("{\"a\":1.50,\"b\":[9007199254740993,-0,1E-400,2e+3]}", streamed);
+    EXPECT_EQ_STRING("1.50", value["a"].asString());
+
+    // compares and hashes like the converted numbers
+    Value eager;
+    EXPECT_EQ_INT(PARSE_OK, Reader().read("{ \"a\" : 1.5, \"b\" : [ 9007199254740993, 0, 0, 2000 ] }", eager));
+    EXPECT_EQ_INT(false, eager["a"].hasRawNumber());
+    EXPECT_EQ_INT(true, (value == eager));
+    EXPECT_EQ_SIZE_T(eager.hash(), value.hash());
+
+    // the text outlives the next document, an assignment drops it
+    Value kept = value["a"];
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[ 7 ]", value));
+    EXPECT_EQ_STRING("1.50", kept.getRawNumber());
+    kept = 2.0;
+    EXPECT_EQ_INT(false, kept.hasRawNumber());
+    EXPECT_EQ_STRING("", kept.getRawNumber());
+
+    // overflow and schema ranges still convert while parsing
+    EXPECT_EQ_INT(PARSE_NUMBER_OVERFLOW, reader.read("[ 1, -1e309 ]", value));
+    EXPECT_EQ_INT(PARSE_NUMBER_OVERFLOW, reader.read("1000e306", value));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("-1.5e250", value));
+    EXPECT_EQ_INT(true, value.hasRawNumber());
+    Schema schema;
+    EXPECT_EQ_INT(PARSE_OK, schema.compile("{ \"type\" : \"array\", \"items\" : { \"minimum\" : 0 } }"));
+    EXPECT_EQ_INT(PARSE_SCHEMA_MISMATCH, reader.read("[ 1, -1 ]", value, schema));
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[ 1, 2 ]", value, schema));
+    EXPECT_EQ_INT(false, value[0].hasRawNumber());
+}
+
+static void test_compact() {
+    Reader reader;
+    Value value;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("{ \"name\" : \"a string long enough to live on the heap\", \"list\" : [ 1, 2, 3 ] }", value));
+    Value record = value;
+    record["name"] = "another string long enough to live on the heap";
+    value["list"].append(record);
+    value["list"].resize(5);
+    value["list"][4] = "a string long enough to live on the heap";
+    value.removeMember("missing");
+    value["list"][0].setComment("// first");
+    Value before = value;
+    value.compact();
+    EXPECT_EQ_INT(true, (value == before));
+    EXPECT_EQ_SIZE_T(before.hash(), value.hash());
+    EXPECT_EQ_STRING(FastWriter().write(before), FastWriter().write(value));
+    EXPECT_EQ_STRING("// first", value["list"][0].getComment());
+
+    // equal strings and a subtree held many times are stored once
+    Value repeated;
+    EXPECT_EQ_INT(PARSE_OK, reader.read("[]", repeated));
+    // record handed out a reference, so each copy of it would get its own object
+    const Value held = record;
+    for (int i = 0; i < 100; i++) {
+        repeated.append("a string long enough to live on the heap");
+        repeated.append(held);
+    }
+    size_t allocations = allocation_count;
+    repeated.compact();
+    EXPECT_EQ_INT(true, (allocation_count - allocations < 40));
+    EXPECT_EQ_STRING("another string long enough to live on the heap", repeated[199]["name"].asString());
+
+    // lazy numbers and packed arrays keep their form
+    Features features;
+    features.lazyNumbers = true;
+    EXPECT_EQ_INT(PARSE_OK, Reader(features).read("{ \"big\" : 9007199254740993, \"x\" : 1.50 }", value));
+    value["x"] = 2.0;
+    value.compact();
+    EXPECT_EQ_STRING("9007199254740993", value["big"].getRawNumber());
+    EXPECT_EQ_INT(true, (value["big"].asInt() == 9007199254740993LL));
+    EXPECT_EQ_STRING("{ \"big\" : 9007199254740993 , \"x\" : 2 }", FastWriter().write(value));
+    std::string numbers = "[ 1";
+    for (int i = 2; i <= 20; i++)
+        numbers += ", " + std::to_string(i);
+    EXPECT_EQ_INT(PARSE_OK, reader.read(numbers + " ]", value));
+    value.compact();
+    EXPECT_EQ_INT(true, value.isPacked());
+    EXPECT_EQ_DOUBLE(20.0, value.packedNumbers()[19]);
+}
+
 static void test_parse() {
     test_parse_null();
     test_parse_true();
@@ -281,7 +1595,7 @@ static void test_convert() {
                         "\"o\" : { \"1\" : 1, \"2\" : 2, \"3\" : 3  }"
                       " } "
                       );
-    EXPECT_EQ_INT(PARSE_OK, reader.parse(json_source, value));
+    EXPECT_EQ_INT(PARSE_OK, reader.read(json_source, value));
     EXPECT_EQ_INT(JSON_OBJECT, value.get_type());
     
     FastWriter fw;
@@ -295,6 +1609,26 @@ static void test_convert() {
 
 int main() {
     test_parse();
+    test_bind();
+    test_equal_and_diff();
+    test_copy_on_write();
+    test_parallel_write();
+    test_parallel_parse();
+    test_minify_prettify();
+    test_validate_utf8();
+    test_accessor();
+    test_gzip_ndjson();
+    test_schema();
+    test_reuse_storage();
+    test_stream_writer();
+    test_frozen_document();
+    test_shape_cache();
+    test_offset_index();
+    test_columns();
+    test_array_reader();
+    test_packed_numbers();
+    test_lazy_numbers();
+    test_compact();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     test_convert();
     return main_ret;